@@ -69,6 +69,8 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+char*           kalloc_kernel(void);
+char*           kalloc_huge(void);
 void            kfree(char*);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
@@ -191,8 +193,13 @@ int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
 void			ipt_init();      				// inverted page table
 void 			ipt_remove_by_pid(uint pid);	//IPT 관리 함수
+void			ipt_clone(pde_t*, uint, uint);	//fork 시 자식 매핑 일괄 등록
 void			sw_tlb_init(void);				//TLB 초기화 함수
-void 			sw_tlb_flush_pid(uint pid);
+void			sw_tlb_flush_proc(struct proc*);
+void			sw_tlb_fork_warm(struct proc*, struct proc*);
+void			sw_tlb_invalidate_range(uint, uint, uint);
+void			sw_ptlb_invalidate(struct proc*, uint, uint);
+void			sw_tlb_print_status(void);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
@@ -33,14 +33,18 @@ struct physframe_info {
 struct physframe_info pf_table[PFNNUM];
 
 
+#define NHUGE (PHYSTOP >> PDXSHIFT) // 물리 메모리의 4MB 영역 수
+
 struct run {
   struct run *next;
+  struct run *prev;  // 큰 페이지를 만들 때 free list 가운데의 페이지를 빼낼 수 있도록 양방향으로 잇는다.
 };
 
 struct {
   struct spinlock lock;
   int use_lock;
   struct run *freelist;
+  uint nfree[NHUGE]; // 4MB 영역별 빈 페이지 수 (모두 비어 있는 영역을 큰 페이지로 쓴다.)
 } kmem;
 
 // Initialization happens in two phases.
@@ -108,8 +112,12 @@ kfree(char *v)
   pf_table[frame_idx].start_tick = 0;
 
   r = (struct run*)v;
+  r->prev = 0;
   r->next = kmem.freelist;
+  if(r->next)
+    r->next->prev = r;
   kmem.freelist = r;
+  kmem.nfree[pa >> PDXSHIFT]++;
   if(kmem.use_lock)
     release(&kmem.lock);
 }
@@ -117,8 +125,9 @@ kfree(char *v)
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
-char*
-kalloc(void)
+// If track is 0 the frame is not charged to the current process.
+static char*
+kalloc_frame(int track)
 {
   struct run *r;
 
@@ -128,10 +137,13 @@ kalloc(void)
   
   if(r) {
     kmem.freelist = r->next;
+    if(r->next)
+      r->next->prev = 0;
+    kmem.nfree[V2P((char *)r) >> PDXSHIFT]--;
     struct proc *p;
 
     p = 0;
-    if (kmem.use_lock && tracing_initialized)
+    if (track && kmem.use_lock && tracing_initialized)
       p = myproc();
 
     //유저 프로세스가 할당하는 경우만 추적
@@ -166,6 +178,89 @@ kalloc(void)
   return (char*)r;
 }
 
+char*
+kalloc(void)
+{
+  return kalloc_frame(1);
+}
+
+/**
+ * @brief 특정 프로세스에 귀속되지 않는 커널 내부용 페이지를 할당한다.
+ *
+ * IPT 엔트리 풀처럼 여러 프로세스가 공유하는 커널 자료구조는 할당 시점의
+ * 프로세스가 종료되어도 해제되지 않으므로 pf_table에 해당 PID로 기록하지 않는다.
+ *
+ * @return 할당된 페이지의 커널 가상 주소, 실패 시 0
+ */
+char*
+kalloc_kernel(void)
+{
+  return kalloc_frame(0);
+}
+
+/**
+ * @brief 4MB로 정렬된 연속 물리 페이지 1024개를 할당한다. (PSE 큰 페이지용)
+ *
+ * 4MB 영역마다 빈 페이지 수를 세어 두므로 모두 비어 있는 영역을 바로 찾고, 그 페이지들을 free list에서 빼낸다.
+ * 빼낸 뒤에는 보통 페이지와 같아서 해제는 페이지마다 kfree()로 한다. (큰 페이지를 4KB 페이지로 쪼개도 그대로 해제할 수 있다.)
+ * pf_table에는 1024개 프레임을 모두 현재 프로세스의 것으로 기록한다.
+ *
+ * @return 4MB 영역의 커널 가상 주소, 모두 비어 있는 영역이 없으면 0 (호출자는 4KB 페이지로 대신한다.)
+ */
+char*
+kalloc_huge(void)
+{
+  struct run *r;
+  struct proc *p = 0;
+  uint h, i, pa, frame_idx, tick = 0;
+
+  if(!kmem.use_lock)
+    return 0;
+  if(tracing_initialized)
+    p = myproc();
+  if(p && p->pid > 0){
+    acquire(&tickslock);
+    tick = ticks;
+    release(&tickslock);
+  }
+
+  acquire(&kmem.lock);
+
+  //1. 모두 비어 있는 4MB 영역을 찾는다. (영역 0에는 커널이 있다.)
+  for(h = 1; h < NHUGE && kmem.nfree[h] != NPTENTRIES; h++)
+    ;
+  if(h == NHUGE){
+    release(&kmem.lock);
+    return 0;
+  }
+
+  //2. 영역의 페이지를 free list에서 빼내고, 유저 프로세스가 할당하는 경우 전역 테이블에 기록한다.
+  for(i = 0; i < NPTENTRIES; i++){
+    pa = (h << PDXSHIFT) + i * PGSIZE;
+    r = (struct run*)P2V(pa);
+    if(r->prev)
+      r->prev->next = r->next;
+    else
+      kmem.freelist = r->next;
+    if(r->next)
+      r->next->prev = r->prev;
+
+    if(p && p->pid > 0){
+      frame_idx = pa / PGSIZE;
+      if(frame_idx >= PFNNUM)
+        panic("kalloc_huge: frame index out of bounds");
+      pf_table[frame_idx].frame_index = frame_idx;
+      pf_table[frame_idx].allocated = 1;
+      pf_table[frame_idx].start_tick = tick;
+      pf_table[frame_idx].pid = p->pid;
+    }
+  }
+  kmem.nfree[h] = 0;
+
+  release(&kmem.lock);
+  return (char*)P2V(h << PDXSHIFT);
+}
+
 
 /**
  * @brief 커널 영역의 전역 프레임 정보를 사용자 공간으로 추가하기 위한 시스템 콜
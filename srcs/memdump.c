@@ -4,18 +4,97 @@
 #include "fcntl.h"
 
 #define MAX_FRINFO 60000 
+#define RANGE_BATCH 256
 
 static void
 usage(void)
 {
-    printf(1, "usage: memdump [-a] [-p PID]\n");
+    printf(1, "usage: memdump [-a] [-p PID] [-r START END]\n");
+    printf(1, "       memdump -i [-p PID] [-s]\n");
     exit();
 }
 
+/**
+ * @brief IPT 매핑 목록을 출력한다.
+ */
+static void
+print_pvlist(struct pvlist *buf, int n)
+{
+    for (int i = 0; i < n; i++)
+        printf(1, "%d\t\t%d\t0x%x\t0x%x\t%d\n",
+            buf[i].pfn, buf[i].pid, buf[i].va, buf[i].flags, buf[i].refcnt);
+}
+
+/**
+ * @brief phys2virt_range() 시스템 콜로 프레임 [start, end) 범위의 IPT 매핑을 pfn 순서로 출력한다.
+ * @param start : 시작 프레임 번호
+ * @param end : 끝 프레임 번호 (포함하지 않음)
+ */
+static void
+dump_range(uint start, uint end)
+{
+    static struct pvlist buf[RANGE_BATCH];
+    struct prange r;
+    int n, total = 0;
+
+    r.pa = start * 4096;
+    r.pa_end = end * 4096;
+    r.after = 0;
+
+    printf(1, "[memdump] frames %d-%d\n", start, end - 1);
+    printf(1, "[frame#]\t[pid]\t[va]\t\t[flags]\t[ref]\n");
+
+    //1. 버퍼가 가득 찰 때마다 이어서 조회한다.
+    while (r.pa < r.pa_end) {
+        n = phys2virt_range(&r, buf, RANGE_BATCH);
+        if (n < 0) {
+            printf(1, "memdump: phys2virt_range failed\n");
+            exit();
+        }
+        print_pvlist(buf, n);
+        total += n;
+    }
+    printf(1, "[memdump] %d mappings\n", total);
+}
+
+/**
+ * @brief ipt_export() 시스템 콜로 IPT 전체를 pfn 순서로 출력한다.
+ * @param pid : 0이 아니면 이 PID의 매핑만 출력한다.
+ * @param shared : 1이면 refcnt가 2 이상인 매핑만 출력한다.
+ */
+static void
+dump_ipt(int pid, int shared)
+{
+    static struct pvlist buf[RANGE_BATCH];
+    struct ipt_export c;
+    int n, total = 0;
+
+    memset(&c, 0, sizeof(c));
+    c.pid = pid;
+    c.shared = shared;
+
+    printf(1, "[memdump] IPT export pid=%d shared=%d\n", pid, shared);
+    printf(1, "[frame#]\t[pid]\t[va]\t\t[flags]\t[ref]\n");
+
+    //1. 버퍼가 가득 찰 때마다 이어서 읽는다.
+    while (!c.done) {
+        n = ipt_export(&c, buf, RANGE_BATCH);
+        if (n < 0) {
+            printf(1, "memdump: ipt_export failed\n");
+            exit();
+        }
+        print_pvlist(buf, n);
+        total += n;
+    }
+    printf(1, "[memdump] %d mappings\n", total);
+}
+
 /**
  * @brief dump_physmem_info() 시스템 콜을 호출해 받아온 프레임 정보를 표 형태로 출력한다.
  * @param -a : free 프레임을 포함한 전체 프레임 테이블을 출력한다.asm
  * @param -p <PID> : 특정 PID가 점유한 프레임만 출력한다.
+ * @param -r <START> <END> : 프레임 [START, END) 범위의 IPT 매핑을 pfn 순서로 출력한다.
+ * @param -i : IPT 전체를 pfn 순서로 출력한다. (-p <PID>로 거르고, -s면 공유된 매핑만)
  * 
  * @return
  */
@@ -27,12 +106,20 @@ int main(int argc, char *argv[])
     //0. 옵션 처리 변수 할당
     int all = 0;
     int pid = -1;
+    int ipt = 0;
+    int shared = 0;
 
     //1. 옵션 파싱
     for(int i = 1; i < argc; i++) {
         if (!strcmp(argv[i], "-a")) {
             all = 1;
         }
+        else if (!strcmp(argv[i], "-i")) {
+            ipt = 1;
+        }
+        else if (!strcmp(argv[i], "-s")) {
+            shared = 1;
+        }
         else if (!strcmp(argv[i], "-p")) {
             if (i + 1 >= argc) {
                 usage();
@@ -43,12 +130,33 @@ int main(int argc, char *argv[])
                 usage();
             }
         }
+        else if (!strcmp(argv[i], "-r")) {
+            if (i + 2 >= argc) {
+                usage();
+            }
+            int start = atoi(argv[i + 1]);
+            int end = atoi(argv[i + 2]);
+            if (start < 0 || end <= start) {
+                usage();
+            }
+            dump_range(start, end);
+            exit();
+        }
     }
 
     //1-1. 중복 옵션 usage()처리
     if (all == 1 && pid > 0) {
         usage();
     }
+    if ((ipt && all) || (shared && !ipt)) {
+        usage();
+    }
+
+    //1-2. IPT 출력
+    if (ipt) {
+        dump_ipt(pid > 0 ? pid : 0, shared);
+        exit();
+    }
 
     //2. 구현된 내용 - 시스템 콜 호출을 통해 전역 테이블 정보 받아옴
     static struct physframe_info buf[MAX_FRINFO];
@@ -3,9 +3,14 @@
 #include "user.h"
 #include "fcntl.h"
 
+//TLB_POLICY_* 번호 순서의 정책 이름
+static char *policies[TLB_POLICY_NUM] = { "plru", "lru", "fifo", "random", "clock", "direct" };
+//TLB_L2_* 번호 순서의 L2 동작 방식 이름
+static char *l2_modes[3] = { "off", "incl", "excl" };
+
 static void
 usage(void) {
-  printf(1, "usage: memstress [-n pages] [-t ticks] [-w]\n");
+  printf(1, "usage: memstress [-n pages] [-t ticks] [-w] [-v passes] [-P plru|lru|fifo|random|clock|direct] [-V 0|1] [-L off|incl|excl] [-T 0|1] [-F pages] [-S entries|auto] [-C class] [-H 0|1]\n");
   exit();
 }
 
@@ -16,6 +21,15 @@ main(int argc, char *argv[])
   int pages = 10;
   int do_write = 0;
   int hold_ticks = 200;
+  int vtop_passes = 0;
+  int policy = -1;
+  int victim = -1;
+  int l2 = -1;
+  int private = -1;
+  int prefetch = -1;
+  int size = -1;
+  int cls = -1;
+  int huge = -1;
 
   // 2. 옵션 파싱
   for(int i = 1; i < argc; i++) {
@@ -36,12 +50,126 @@ main(int argc, char *argv[])
     else if (!strcmp(argv[i], "-w")) {
       do_write = 1;
     }
+    // 2-2. -v 옵션: 각 페이지를 vtop으로 passes 번 훑어 SW TLB에 부하를 준다.
+    else if (!strcmp(argv[i], "-v")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      vtop_passes = atoi(argv[i]);
+      if (vtop_passes <= 0) vtop_passes = 0;
+    }
+    // 2-3. -P 옵션: SW TLB 교체 정책을 바꾼다. (TLB와 통계를 비운 상태에서 시작)
+    else if (!strcmp(argv[i], "-P")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      for (policy = 0; policy < TLB_POLICY_NUM; policy++) {
+        if (!strcmp(argv[i], policies[policy]))
+          break;
+      }
+      if (policy == TLB_POLICY_NUM) usage();
+    }
+    // 2-4. -V 옵션: SW TLB victim buffer를 끄거나(0) 켠다(1).
+    else if (!strcmp(argv[i], "-V")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      victim = atoi(argv[i]) != 0;
+    }
+    // 2-5. -L 옵션: 공유 L2 TLB 동작 방식을 바꾼다.
+    else if (!strcmp(argv[i], "-L")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      for (l2 = 0; l2 < 3; l2++) {
+        if (!strcmp(argv[i], l2_modes[l2]))
+          break;
+      }
+      if (l2 == 3) usage();
+    }
+    // 2-6. -T 옵션: 공유 TLB 대신 프로세스 전용 TLB를 쓴다(1).
+    else if (!strcmp(argv[i], "-T")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      private = atoi(argv[i]) != 0;
+    }
+    // 2-7. -F 옵션: TLB 미스 때 선반입할 최대 페이지 수 (0이면 끔)
+    else if (!strcmp(argv[i], "-F")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      prefetch = atoi(argv[i]);
+      if (prefetch < 0) usage();
+    }
+    // 2-8. -S 옵션: CPU별 L1 TLB 엔트리 수 (auto이면 미스율에 따라 자동 조절)
+    else if (!strcmp(argv[i], "-S")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      size = strcmp(argv[i], "auto") ? atoi(argv[i]) : 0;
+      if (size < 0) usage();
+    }
+    // 2-9. -C 옵션: 이 프로세스의 TLB 분할 클래스 (tlbstat -m으로 정한 way에만 채운다.)
+    else if (!strcmp(argv[i], "-C")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      cls = atoi(argv[i]);
+      if (cls < 0 || cls >= TLB_CLASS_NUM) usage();
+    }
+    // 2-10. -H 옵션: 4MB로 정렬된 큰 sbrk 증가분을 큰 페이지로 매핑할지(1) 4KB 페이지만 쓸지(0)
+    else if (!strcmp(argv[i], "-H")) {
+      if (i + 1 >= argc) usage();
+      i++;
+      huge = atoi(argv[i]) != 0;
+    }
   }
 
   //3. 상태 출력
   int pid = getpid();
   printf(1, "[memstress] pid=%d pages=%d hold=%d ticks write=%d\n", pid, pages, hold_ticks, do_write);
 
+  if (policy >= 0) {
+    tlb_ctl(TLB_CTL_POLICY, policy);
+    printf(1, "[memstress] tlb policy=%s\n", policies[policy]);
+  }
+  if (victim >= 0) {
+    tlb_ctl(TLB_CTL_VICTIM, victim);
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] tlb victim buffer=%s\n", victim ? "on" : "off");
+  }
+  if (l2 >= 0) {
+    tlb_ctl(TLB_CTL_L2, l2);
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] tlb L2=%s\n", l2_modes[l2]);
+  }
+  if (private >= 0) {
+    tlb_ctl(TLB_CTL_PRIVATE, private);
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] tlb private=%s\n", private ? "on" : "off");
+  }
+  if (prefetch >= 0) {
+    tlb_ctl(TLB_CTL_PREFETCH, prefetch);
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] tlb prefetch=%d\n", prefetch);
+  }
+  if (size == 0) {
+    tlb_ctl(TLB_CTL_AUTOSIZE, 1);
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] tlb size=auto (now %d entries)\n", tlb_ctl(TLB_CTL_SIZE, -1));
+  }
+  else if (size > 0) {
+    tlb_ctl(TLB_CTL_AUTOSIZE, 0);
+    if (tlb_ctl(TLB_CTL_SIZE, size) < 0) {
+      printf(1, "[memstress] invalid tlb size %d\n", size);
+      exit();
+    }
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] tlb size=%d entries\n", size);
+  }
+  if (cls >= 0) {
+    tlb_ctl(TLB_CTL_CLASS, cls);
+    printf(1, "[memstress] tlb class=%d\n", cls);
+  }
+  if (huge >= 0) {
+    tlb_ctl(TLB_CTL_HUGE, huge);
+    tlb_ctl(TLB_CTL_RESET_STATS, 0);
+    printf(1, "[memstress] huge pages=%s\n", huge ? "on" : "off");
+  }
+
   //4. 메모리를 할당한다.
   int inc = pages * 4096; 
   char *base = sbrk(inc);
@@ -57,6 +185,17 @@ main(int argc, char *argv[])
     }
   }
 
+  //6. -v옵션일 경우 모든 페이지를 vtop으로 반복 변환하고 TLB 통계를 출력한다.
+  if (vtop_passes > 0) {
+    uint pa, flags;
+    for (int v = 0; v < vtop_passes; v++) {
+      for (int p = 0; p < pages; p++) {
+        vtop(base + p*4096, &pa, &flags);
+      }
+    }
+    print_ipt_status();
+  }
+
   sleep(hold_ticks);
 
   printf(1, "[memstress] pid=%d done\n", pid);
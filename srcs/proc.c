@@ -88,6 +88,9 @@ allocproc(void)
 found:
   p->state = EMBRYO;
   p->pid = nextpid++;
+  sw_tlb_flush_proc(p);   // 이전에 이 슬롯을 쓴 프로세스의 TLB 엔트리와 섞이지 않도록 새로 배정받고 전용 TLB를 비운다.
+  p->tlb_class = 0;
+  p->tlb_pgdir = 0;
 
   release(&ptable.lock);
 
@@ -197,6 +200,12 @@ fork(void)
     return -1;
   }
   np->sz = curproc->sz;
+  // SW TLB 분할 클래스를 물려받는다. (예열도 자식 클래스의 way에만 채운다.)
+  np->tlb_class = curproc->tlb_class;
+  // 자식의 매핑을 IPT에 한 번에 등록한다.
+  ipt_clone(np->pgdir, np->sz, np->pid);
+  // 부모가 지금 쓰는 페이지의 변환으로 자식 SW TLB를 미리 채운다.
+  sw_tlb_fork_warm(curproc, np);
   np->parent = curproc;
   *np->tf = *curproc->tf;
 
@@ -261,9 +270,9 @@ exit(void)
     }
   }
 
-  // 종료 프로세스의 PID에 해당하는 모든 IPT 엔트리를 삭제한다.
+  // 종료 프로세스의 PID에 해당하는 모든 IPT 엔트리를 삭제하고, TLB 태그를 버린다.
   ipt_remove_by_pid(curproc->pid);
-  sw_tlb_flush_pid(curproc->pid);
+  sw_tlb_flush_proc(curproc);
 
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
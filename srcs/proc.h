@@ -0,0 +1,75 @@
+// Per-CPU state
+struct cpu {
+  uchar apicid;                // Local APIC ID
+  struct context *scheduler;   // swtch() here to enter scheduler
+  struct taskstate ts;         // Used by x86 to find stack for interrupt
+  struct segdesc gdt[NSEGS];   // x86 global descriptor table
+  volatile uint started;       // Has the CPU started?
+  int ncli;                    // Depth of pushcli nesting.
+  int intena;                  // Were interrupts enabled before pushcli?
+  struct proc *proc;           // The process running on this cpu or null
+};
+
+extern struct cpu cpus[NCPU];
+extern int ncpu;
+
+//PAGEBREAK: 17
+// Saved registers for kernel context switches.
+// Don't need to save all the segment registers (%cs, etc),
+// because they are constant across kernel contexts.
+// Don't need to save %eax, %ecx, %edx, because the
+// x86 convention is that the caller has saved them.
+// Contexts are stored at the bottom of the stack they
+// describe; the stack pointer is the address of the context.
+// The layout of the context matches the layout of the stack in swtch.S
+// at the "Switch stacks" comment. Switch doesn't save eip explicitly,
+// but it is on the stack and allocproc() manipulates it.
+struct context {
+  uint edi;
+  uint esi;
+  uint ebx;
+  uint ebp;
+  uint eip;
+};
+
+enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
+
+#define PTLB_SIZE 16           // 프로세스 전용 SW TLB 엔트리 수 (direct-mapped)
+
+// 프로세스 전용 SW TLB 엔트리
+struct ptlb_entry {
+  uint va_page;                // 가상 페이지 번호
+  uint pa_page;                // 물리 페이지 번호
+  uint flags;                  // PTE 플래그
+  int valid;                   // 유효 비트
+  int prefetched;              // 선반입으로 채워졌고 아직 히트가 없으면 1
+};
+
+// Per-process state
+struct proc {
+  uint sz;                     // Size of process memory (bytes)
+  pde_t* pgdir;                // Page table
+  char *kstack;                // Bottom of kernel stack for this process
+  enum procstate state;        // Process state
+  int pid;                     // Process ID
+  struct proc *parent;         // Parent process
+  struct trapframe *tf;        // Trap frame for current syscall
+  struct context *context;     // swtch() here to run process
+  void *chan;                  // If non-zero, sleeping on chan
+  int killed;                  // If non-zero, have been killed
+  struct file *ofile[NOFILE];  // Open files
+  struct inode *cwd;           // Current directory
+  char name[16];               // Process name (debugging)
+  uint tlb_tag;                // SW TLB 태그 (세대 << 8 | ASID), 0이면 아직 배정되지 않음
+  struct ptlb_entry ptlb[PTLB_SIZE]; // 전용 SW TLB (전용 TLB 모드에서 공유 TLB 대신 사용)
+  uint tlb_pf_next;            // 순차 접근이면 다음 TLB 미스가 날 가상 페이지 (선반입 stride 검출)
+  uint tlb_pf_degree;          // 현재 선반입 페이지 수
+  int tlb_class;               // SW TLB 분할 클래스 (교체할 way를 고를 마스크, fork 때 물려받는다.)
+  pde_t* tlb_pgdir;            // TLB 태그가 가리키는 주소 공간 (switchuvm에서 pgdir와 다르면 태그를 버린다.)
+};
+
+// Process memory is laid out contiguously, low addresses first:
+//   text
+//   original data and bss
+//   fixed-size stack
+//   expandable heap
@@ -0,0 +1,562 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+/**
+ * @brief 사이클 카운터의 하위 32비트를 읽는다.
+ *        측정 구간이 짧으므로 하위 32비트 차이만으로 충분하다.
+ */
+static inline uint
+rdtsc(void)
+{
+  uint lo, hi;
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return lo;
+}
+
+static void
+usage(void)
+{
+  printf(1, "usage: ptbench -f [-n iters] [-p pages]\n");
+  printf(1, "       ptbench -m [-n iters] [-p pages]\n");
+  printf(1, "       ptbench -v [-n iters] [-p pages]\n");
+  printf(1, "       ptbench -h [-n iters] [-p pages] [-c procs]\n");
+  printf(1, "       ptbench -d [-n iters]\n");
+  printf(1, "       ptbench -w [-n iters] [-p pages]\n");
+  printf(1, "       ptbench -s [-z]\n");
+  exit();
+}
+
+/**
+ * @brief fork + wait 를 iters 번 반복하고 회당 평균 비용(천 사이클 단위)을 반환한다.
+ */
+static uint
+fork_kcycles(int iters)
+{
+  uint total = 0;
+  uint t0;
+  int i, pid;
+
+  for (i = 0; i < iters; i++) {
+    t0 = rdtsc();
+    pid = fork();
+    if (pid < 0) {
+      printf(1, "[ptbench] fork failed\n");
+      exit();
+    }
+    if (pid == 0)
+      exit();
+    wait();
+    total += (rdtsc() - t0) / 1000;
+  }
+  return total / iters;
+}
+
+/**
+ * @brief IPT 추적을 켠 상태와 끈 상태의 fork 지연을 비교한다.
+ *
+ * @param iters 측정 반복 횟수
+ * @param pages fork 전에 부모가 확보해 둘 힙 페이지 수
+ */
+static void
+bench_fork(int iters, int pages)
+{
+  uint on, off;
+  char *base;
+  int p;
+
+  //1. 자식에게 복사될 힙을 만든다.
+  base = sbrk(pages * 4096);
+  if (base == (char*)-1) {
+    printf(1, "[ptbench] sbrk failed\n");
+    exit();
+  }
+  for (p = 0; p < pages; p++)
+    base[p*4096] = (char)p;
+
+  //2. 추적을 켠 상태와 끈 상태를 번갈아 측정한다. (첫 회는 워밍업)
+  fork_kcycles(1);
+  on = fork_kcycles(iters);
+  ipt_ctl(IPT_CTL_TRACK, 0);
+  off = fork_kcycles(iters);
+  ipt_ctl(IPT_CTL_TRACK, 1);
+
+  //3. 결과 출력
+  printf(1, "[ptbench] fork x%d, %d heap pages\n", iters, pages);
+  printf(1, "  tracking on : %d kcycles/fork\n", on);
+  printf(1, "  tracking off: %d kcycles/fork\n", off);
+  if (off > 0)
+    printf(1, "  overhead    : %d%%\n", on > off ? (on - off) * 100 / off : 0);
+}
+
+/**
+ * @brief sbrk로 pages 개를 매핑했다가 해제하기를 iters 번 반복하고 회당 평균 비용(천 사이클 단위)을 반환한다.
+ */
+static uint
+map_kcycles(int iters, int pages)
+{
+  uint total = 0;
+  uint t0;
+  int i;
+
+  for (i = 0; i < iters; i++) {
+    t0 = rdtsc();
+    if (sbrk(pages * 4096) == (char*)-1) {
+      printf(1, "[ptbench] sbrk failed\n");
+      exit();
+    }
+    sbrk(-pages * 4096);
+    total += (rdtsc() - t0) / 1000;
+  }
+  return total / iters;
+}
+
+/**
+ * @brief IPT 즉시 반영 모드와 지연(로그) 모드의 매핑 경로 비용을 비교한다.
+ *
+ * @param iters 측정 반복 횟수
+ * @param pages 한 번에 매핑/해제할 페이지 수
+ */
+static void
+bench_map(int iters, int pages)
+{
+  struct ipt_stat st;
+  uint sync, defer, flush, t0;
+
+  //1. 즉시 반영 모드 측정 (첫 회는 워밍업)
+  map_kcycles(1, pages);
+  sync = map_kcycles(iters, pages);
+
+  //2. 지연 모드 측정
+  ipt_ctl(IPT_CTL_RESET_STATS, 0);
+  ipt_ctl(IPT_CTL_DEFER, 1);
+  defer = map_kcycles(iters, pages);
+
+  //3. 마지막으로 쌓인 로그를 반영하는 비용 (ipt_stat이 반영을 유발한다)
+  t0 = rdtsc();
+  ipt_stat(&st);
+  flush = (rdtsc() - t0) / 1000;
+  ipt_ctl(IPT_CTL_DEFER, 0);
+
+  //4. 결과 출력
+  printf(1, "[ptbench] sbrk map+unmap x%d, %d pages\n", iters, pages);
+  printf(1, "  sync    : %d kcycles/round\n", sync);
+  printf(1, "  deferred: %d kcycles/round\n", defer);
+  printf(1, "  flush   : %d kcycles, %d drains, %d records applied\n",
+         flush, st.log_drains, st.log_applied);
+}
+
+/**
+ * @brief base부터 pages 개 페이지를 vtop으로 iters 번 훑고, 호출당 평균 비용(사이클)을 반환한다.
+ *        pages가 TLB 크기보다 충분히 크면 거의 모든 호출이 TLB 미스이다.
+ *
+ * @param random 1이면 페이지를 의사 난수 순서로, 0이면 순서대로 방문한다.
+ */
+static uint
+vtop_cycles(char *base, int iters, int pages, int random)
+{
+  uint total = 0;
+  uint seed = 12345;
+  uint pa, flags, t0;
+  int i, p, r;
+
+  for (i = 0; i < iters; i++) {
+    for (p = 0; p < pages; p++) {
+      if (random) {
+        seed = seed * 1103515245 + 12345;
+        r = (seed >> 16) % pages;
+      } else {
+        r = p;
+      }
+      t0 = rdtsc();
+      vtop(base + r * 4096, &pa, &flags);
+      total += rdtsc() - t0;
+    }
+  }
+  return total / (iters * pages);
+}
+
+/**
+ * @brief TLB 미스를 페이지 테이블 순회로 처리할 때와 IPT (pid, va) 인덱스로 처리할 때의 지연을 비교한다.
+ *
+ * @param iters 측정 반복 횟수
+ * @param pages 훑을 페이지 수 (TLB 크기보다 커야 미스가 난다)
+ */
+static void
+bench_vtop(int iters, int pages)
+{
+  static char *names[2] = { "sequential", "random" };
+  uint radix, hashed;
+  char *base;
+  int p, pat;
+
+  //1. 훑을 힙을 만든다.
+  base = sbrk(pages * 4096);
+  if (base == (char*)-1) {
+    printf(1, "[ptbench] sbrk failed\n");
+    exit();
+  }
+  for (p = 0; p < pages; p++)
+    base[p*4096] = (char)p;
+
+  //2. 접근 패턴마다 두 방식을 번갈아 측정한다.
+  printf(1, "[ptbench] vtop x%d, %d pages\n", iters, pages);
+  for (pat = 0; pat < 2; pat++) {
+    ipt_ctl(IPT_CTL_VTOP, 0);
+    radix = vtop_cycles(base, iters, pages, pat);
+    ipt_ctl(IPT_CTL_VTOP, 1);
+    hashed = vtop_cycles(base, iters, pages, pat);
+    ipt_ctl(IPT_CTL_VTOP, 0);
+
+    printf(1, "  %s\n", names[pat]);
+    printf(1, "    radix walk : %d cycles/vtop\n", radix);
+    printf(1, "    hashed IPT : %d cycles/vtop\n", hashed);
+  }
+}
+
+/**
+ * @brief procs 개 프로세스가 동시에 base부터 pages 개 페이지를 vtop으로 훑고, 호출당 평균 비용(사이클)을 반환한다.
+ *        각 프로세스는 한 번 훑어 TLB를 채운 뒤 측정하고, 결과를 파이프로 부모에게 보낸다.
+ */
+static uint
+hit_cycles(char *base, int iters, int pages, int procs)
+{
+  uint r, total = 0;
+  int fd[2];
+  int c, pid;
+
+  if (pipe(fd) < 0) {
+    printf(1, "[ptbench] pipe failed\n");
+    exit();
+  }
+  for (c = 0; c < procs; c++) {
+    pid = fork();
+    if (pid < 0) {
+      printf(1, "[ptbench] fork failed\n");
+      exit();
+    }
+    if (pid == 0) {
+      close(fd[0]);
+      vtop_cycles(base, 1, pages, 0);
+      r = vtop_cycles(base, iters, pages, 0);
+      write(fd[1], &r, sizeof(r));
+      exit();
+    }
+  }
+  close(fd[1]);
+  for (c = 0; c < procs; c++) {
+    if (read(fd[0], &r, sizeof(r)) == sizeof(r))
+      total += r;
+    wait();
+  }
+  close(fd[0]);
+  return total / procs;
+}
+
+/**
+ * @brief L1 히트와 L2 히트의 지연을 L2 조회에 락을 잡을 때와 순번으로 검증할 때 비교한다.
+ *        L1을 기본 크기로 고정하고 선반입을 꺼서, L1보다 큰 작업 집합의 조회가 모두 L2 히트가 되게 한다.
+ *
+ * @param iters 측정 반복 횟수
+ * @param pages L2 히트를 측정할 프로세스당 페이지 수 (L1보다 크고, procs 배 해도 L2보다 작아야 한다)
+ * @param procs 동시에 조회할 프로세스 수
+ */
+static void
+bench_hit(int iters, int pages, int procs)
+{
+  static char *modes[2] = { "locked", "seqcount" };
+  int old_pf, old_l2, old_seq, old_size, old_auto;
+  uint l1, l2;
+  char *base;
+  int p, m;
+
+  //1. 훑을 힙을 만든다. (자식들이 복사본을 훑는다.)
+  base = sbrk(pages * 4096);
+  if (base == (char*)-1) {
+    printf(1, "[ptbench] sbrk failed\n");
+    exit();
+  }
+  for (p = 0; p < pages; p++)
+    base[p*4096] = (char)p;
+
+  //2. 측정 조건을 맞춘다.
+  old_auto = tlb_ctl(TLB_CTL_AUTOSIZE, 0);
+  old_size = tlb_ctl(TLB_CTL_SIZE, 64);
+  old_pf = tlb_ctl(TLB_CTL_PREFETCH, 0);
+  old_l2 = tlb_ctl(TLB_CTL_L2, TLB_L2_INCLUSIVE);
+  old_seq = tlb_ctl(TLB_CTL_L2_SEQ, 0);
+
+  //3. 두 방식을 번갈아 측정한다.
+  printf(1, "[ptbench] TLB hit latency x%d, %d pages, %d procs\n", iters, pages, procs);
+  for (m = 0; m < 2; m++) {
+    tlb_ctl(TLB_CTL_L2_SEQ, m);
+    l1 = hit_cycles(base, iters, 16, procs);
+    l2 = hit_cycles(base, iters, pages, procs);
+
+    printf(1, "  L2 %s\n", modes[m]);
+    printf(1, "    L1 hit : %d cycles/vtop\n", l1);
+    printf(1, "    L2 hit : %d cycles/vtop\n", l2);
+  }
+
+  //4. 설정을 되돌린다.
+  tlb_ctl(TLB_CTL_L2_SEQ, old_seq);
+  tlb_ctl(TLB_CTL_L2, old_l2);
+  tlb_ctl(TLB_CTL_PREFETCH, old_pf);
+  tlb_ctl(TLB_CTL_SIZE, old_size);
+  tlb_ctl(TLB_CTL_AUTOSIZE, old_auto);
+}
+
+/**
+ * @brief 프레임 테이블 전체를 dump_physmem_info로 iters 번 읽고 회당 평균 비용(천 사이클 단위)을 반환한다.
+ */
+static uint
+dump_kcycles(struct physframe_info *buf, int iters)
+{
+  uint total = 0;
+  uint t0;
+  int i;
+
+  for (i = 0; i < iters; i++) {
+    t0 = rdtsc();
+    if (dump_physmem_info(buf, PFNNUM) < 0) {
+      printf(1, "[ptbench] dump_physmem_info failed\n");
+      exit();
+    }
+    total += (rdtsc() - t0) / 1000;
+  }
+  return total / iters;
+}
+
+/**
+ * @brief 큰 덤프에서 copyout의 주소 변환을 매번 페이지 테이블 순회로 할 때와 TLB를 거칠 때를 비교한다.
+ *        dump_physmem_info는 레코드마다 copyout하므로 같은 유저 페이지의 변환을 수백 번씩 반복한다.
+ *
+ * @param iters 측정 반복 횟수
+ */
+static void
+bench_dump(int iters)
+{
+  struct physframe_info *buf;
+  uint walk, tlb;
+  int old;
+
+  //1. 결과 버퍼 (실행 파일의 bss를 키우지 않도록 필요할 때만 확보한다.)
+  buf = (struct physframe_info*)sbrk(PFNNUM * sizeof(struct physframe_info));
+  if (buf == (struct physframe_info*)-1) {
+    printf(1, "[ptbench] sbrk failed\n");
+    exit();
+  }
+
+  //2. 두 방식을 번갈아 측정한다. (첫 회는 워밍업: 버퍼 페이지를 채운다)
+  old = tlb_ctl(TLB_CTL_KCOPY, 0);
+  dump_kcycles(buf, 1);
+  walk = dump_kcycles(buf, iters);
+  tlb_ctl(TLB_CTL_KCOPY, 1);
+  tlb = dump_kcycles(buf, iters);
+  tlb_ctl(TLB_CTL_KCOPY, old);
+
+  //3. 결과 출력
+  printf(1, "[ptbench] dump_physmem_info x%d, %d records\n", iters, PFNNUM);
+  printf(1, "  page walk : %d kcycles/dump\n", walk);
+  printf(1, "  SW TLB    : %d kcycles/dump\n", tlb);
+  if (tlb > 0)
+    printf(1, "  speedup   : %d.%dx\n", walk / tlb, walk * 10 / tlb % 10);
+}
+
+/**
+ * @brief 부모가 pages 개 페이지를 훑은 직후 fork하고, 자식이 같은 페이지를 한 번 훑기를 iters 번 반복한다.
+ *        자식의 TLB 히트/미스는 tlb_stat()의 자식 PID 통계로 모은다.
+ */
+static void
+warm_run(char *base, int iters, int pages, uint *hits, uint *misses)
+{
+  static struct tlb_stat st[128];
+  int i, j, n, pid;
+
+  *hits = *misses = 0;
+  for (i = 0; i < iters; i++) {
+    vtop_cycles(base, 1, pages, 0);
+    pid = fork();
+    if (pid < 0) {
+      printf(1, "[ptbench] fork failed\n");
+      exit();
+    }
+    if (pid == 0) {
+      vtop_cycles(base, 1, pages, 0);
+      exit();
+    }
+    wait();
+    n = tlb_stat(st, 128);
+    for (j = 0; j < n; j++) {
+      if (st[j].pid == pid) {
+        *hits += st[j].hits;
+        *misses += st[j].misses;
+      }
+    }
+  }
+}
+
+/**
+ * @brief fork 때 자식 TLB를 미리 채울 때와 채우지 않을 때 자식의 첫 훑기 적중률을 비교한다.
+ *        선반입은 꺼서 예열의 효과만 본다.
+ *
+ * @param iters 측정 반복 횟수
+ * @param pages 부모와 자식이 훑을 페이지 수 (예열은 부모의 L1에 남은 엔트리 중 최대 32개)
+ */
+static void
+bench_warm(int iters, int pages)
+{
+  static char *modes[2] = { "cold", "warm" };
+  uint hits, misses;
+  int old_pf, old_warm;
+  char *base;
+  int p, m;
+
+  //1. 훑을 힙을 만든다.
+  base = sbrk(pages * 4096);
+  if (base == (char*)-1) {
+    printf(1, "[ptbench] sbrk failed\n");
+    exit();
+  }
+  for (p = 0; p < pages; p++)
+    base[p*4096] = (char)p;
+
+  //2. 두 방식을 번갈아 측정한다.
+  old_pf = tlb_ctl(TLB_CTL_PREFETCH, 0);
+  old_warm = tlb_ctl(TLB_CTL_FORK_WARM, 0);
+  printf(1, "[ptbench] post-fork child vtop x%d, %d pages\n", iters, pages);
+  for (m = 0; m < 2; m++) {
+    tlb_ctl(TLB_CTL_FORK_WARM, m);
+    warm_run(base, iters, pages, &hits, &misses);
+    printf(1, "  %s child : %d hits, %d misses", modes[m], hits, misses);
+    if (hits + misses > 0)
+      printf(1, " (%d%% hit)", hits * 100 / (hits + misses));
+    printf(1, "\n");
+  }
+
+  //3. 설정을 되돌린다.
+  tlb_ctl(TLB_CTL_FORK_WARM, old_warm);
+  tlb_ctl(TLB_CTL_PREFETCH, old_pf);
+}
+
+/**
+ * @brief ipt_stat() 결과를 출력한다.
+ *
+ * @param reset 1이면 출력 후 조회/락 통계를 초기화한다.
+ */
+static void
+show_ipt_stat(int reset)
+{
+  static char *bins[IPT_HIST_BINS] = { "0", "1", "2", "3", "4", "5-8", "9-16", "17+" };
+  struct ipt_stat st;
+  int i;
+
+  if (ipt_stat(&st) < 0) {
+    printf(1, "[ptbench] ipt_stat failed\n");
+    exit();
+  }
+
+  printf(1, "=== IPT Statistics ===\n");
+  printf(1, "entries      : %d\n", st.entries);
+  printf(1, "buckets      : %d (%d used)%s\n", st.buckets, st.used_buckets,
+         st.resizing ? " resizing" : "");
+  printf(1, "max chain    : %d\n", st.max_chain);
+  printf(1, "chain length histogram\n");
+  for (i = 0; i < IPT_HIST_BINS; i++)
+    printf(1, "  %s\t: %d\n", bins[i], st.chain_hist[i]);
+  printf(1, "lookups      : %d (avg %d.%d%d probes)\n", st.lookups,
+         st.avg_probes_x100 / 100, st.avg_probes_x100 / 10 % 10, st.avg_probes_x100 % 10);
+  printf(1, "dup refcnt   : %d\n", st.dup_bumps);
+  printf(1, "operations   : %d\n", st.operations);
+  printf(1, "lock         : %d acquires, %d contended, %d kcycles waiting\n",
+         st.lock_acquires, st.lock_contended, st.lock_wait_kcycles);
+  printf(1, "deferred log : %s, %d drains, %d records\n", st.deferred ? "on" : "off",
+         st.log_drains, st.log_applied);
+
+  if (reset)
+    ipt_ctl(IPT_CTL_RESET_STATS, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mode = 0;
+  int reset = 0;
+  int iters = 20;
+  int pages = 256;
+  int procs = 1;
+
+  //1. 옵션 파싱
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-f")) {
+      mode = 'f';
+    }
+    else if (!strcmp(argv[i], "-m")) {
+      mode = 'm';
+    }
+    else if (!strcmp(argv[i], "-v")) {
+      mode = 'v';
+    }
+    else if (!strcmp(argv[i], "-h")) {
+      mode = 'h';
+    }
+    else if (!strcmp(argv[i], "-d")) {
+      mode = 'd';
+    }
+    else if (!strcmp(argv[i], "-w")) {
+      mode = 'w';
+    }
+    else if (!strcmp(argv[i], "-s")) {
+      mode = 's';
+    }
+    else if (!strcmp(argv[i], "-z")) {
+      reset = 1;
+    }
+    else if (!strcmp(argv[i], "-n")) {
+      if (i + 1 >= argc) usage();
+      iters = atoi(argv[++i]);
+      if (iters <= 0) usage();
+    }
+    else if (!strcmp(argv[i], "-p")) {
+      if (i + 1 >= argc) usage();
+      pages = atoi(argv[++i]);
+      if (pages <= 0) usage();
+    }
+    else if (!strcmp(argv[i], "-c")) {
+      if (i + 1 >= argc) usage();
+      procs = atoi(argv[++i]);
+      if (procs <= 0) usage();
+    }
+    else {
+      usage();
+    }
+  }
+
+  //2. 벤치마크 실행
+  switch (mode) {
+  case 'f':
+    bench_fork(iters, pages);
+    break;
+  case 'm':
+    bench_map(iters, pages);
+    break;
+  case 'v':
+    bench_vtop(iters, pages);
+    break;
+  case 'h':
+    bench_hit(iters, pages, procs);
+    break;
+  case 'd':
+    bench_dump(iters);
+    break;
+  case 'w':
+    bench_warm(iters, pages);
+    break;
+  case 's':
+    show_ipt_stat(reset);
+    break;
+  default:
+    usage();
+  }
+  exit();
+}
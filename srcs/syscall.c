@@ -108,6 +108,13 @@ extern int sys_vtop(void);
 extern int sys_phys2virt(void);
 extern int sys_setpageflags(void);
 extern int sys_print_ipt_status(void);
+extern int sys_ipt_ctl(void);
+extern int sys_ipt_stat(void);
+extern int sys_phys2virt_range(void);
+extern int sys_ipt_export(void);
+extern int sys_tlb_ctl(void);
+extern int sys_tlb_stat(void);
+extern int sys_tlb_part(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -136,6 +143,13 @@ static int (*syscalls[])(void) = {
 [SYS_phys2virt]          sys_phys2virt,
 [SYS_setpageflags]      sys_setpageflags,
 [SYS_print_ipt_status]  sys_print_ipt_status,
+[SYS_ipt_ctl]           sys_ipt_ctl,
+[SYS_ipt_stat]          sys_ipt_stat,
+[SYS_phys2virt_range]   sys_phys2virt_range,
+[SYS_ipt_export]        sys_ipt_export,
+[SYS_tlb_ctl]           sys_tlb_ctl,
+[SYS_tlb_stat]          sys_tlb_stat,
+[SYS_tlb_part]          sys_tlb_part,
 };
 
 void
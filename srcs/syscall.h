@@ -25,3 +25,10 @@
 #define SYS_phys2virt 24 //C 구현 시스템 콜
 #define SYS_setpageflags 25 //C 구현 시스템 콜
 #define SYS_print_ipt_status 26
+#define SYS_ipt_ctl 27
+#define SYS_ipt_stat 28
+#define SYS_phys2virt_range 29
+#define SYS_ipt_export 30
+#define SYS_tlb_ctl 31
+#define SYS_tlb_stat 32
+#define SYS_tlb_part 33
@@ -7,32 +7,6 @@
 #include "mmu.h"
 #include "proc.h"
 
-#define IPT_BUCKETS 1024 //해시 버킷 개수
-
-/**
- * @brief 하나의 물리 페이지에 매핑된 가상 주소 정보를 담는 구조체
- */
-struct vlist {
-  uint pid;   //이 가상 주소를 사용하는 프로세스의 PID
-  uint va;    //매핑된 가상 주소 (페이지 경계로 정렬)
-  ushort flags; //PTE의 권한/상태 플래그 스냅샷
-};
-
-/**
- * @brief IPT의 개별 엔트리를 나타내는 구조체
- */
-extern struct ipt_entry {
-  uint pfn;               //물리 프레임 번호
-  uint pid;               //소유 프로세스 PID
-  uint va;                //매핑된 가상 주소 (페이지 기준))
-  ushort flags;           //PTE 권한 (P/W/U 등 스냅샷))
-  ushort refcnt;          //역참조 카운트 (옵션))
-  struct ipt_entry *next; //해시 체인
-} ipt_entry;
-
-extern struct ipt_entry *ipt_hash[IPT_BUCKETS];
-extern struct spinlock ipt_lock;
-extern uint ipt_hash_func(uint pfn);
 extern int sw_vtop(pde_t *pgdir, const void *va, uint *pa_out, uint *pte_flags_out);
 extern int setpageflags_in(pde_t *pgdir, uint addr, uint flags);
 
@@ -58,59 +32,6 @@ int sys_setpageflags(void) {
   return setpageflags_in(curproc->pgdir, addr, flags);
 }
 
-/**
- * @brief 주어진 물리 주소 페이지가 매핑된 모든 가상 주소(va)와 소유 프로세스의 PID 목록을
- * IPT에서 검색하여 유저 공간으로 복사합니다.
- * @param pa_page : 검색할 물리 페이지 주소 (유저 공간에서 받은 인자)
- * @param out : 결과를 저장할 유저 공간 버퍼 주소 (struct vlist 배열))
- * @param max : 유저 공간 버퍼에 복사할 최대 엔트리 수
- * @return 복사한 개수
- */
-int sys_phys2virt(void) {
-  uint pa_page;
-  struct vlist *out;
-  int max;
-  int copied = 0;
-  uint pfn, bucket;
-  struct ipt_entry *e;
-  struct proc *curproc = myproc();
-
-  //1. 인자 받기
-  if (argint(0, (int *)&pa_page) < 0) return -1;
-  if (argptr(1, (char**)&out, sizeof(struct vlist)) < 0) return -1;
-  if (argint(2, &max) < 0) return -1;
-
-  //if (max <= 0 || max >= 100) return -1;
-
-  //2. 프레임 번호 계산
-  pa_page = PGROUNDDOWN(pa_page);
-  pfn = pa_page / PGSIZE;
-  bucket = ipt_hash_func(pfn);
-
-  acquire(&ipt_lock);
-
-  //3. 해시 버킷에서 검색
-  for (e = ipt_hash[bucket]; e && copied < max; e = e->next) {
-    if (e->pfn == pfn) {
-      struct vlist entry;
-      entry.pid = e->pid;
-      entry.va = e->va;
-      entry.flags = e->flags;
-
-      if (copyout(curproc->pgdir,
-                  (uint)out + (copied * sizeof(struct vlist)),
-                  (char *)&entry,
-                  sizeof(struct vlist)) < 0) {
-        release(&ipt_lock);
-        return -1;
-      }
-      copied++;
-    }
-  }
-  release(&ipt_lock);
-  return copied;
-}
-
 /**
  * @brief 주어진 가상 주소에 매핑된 물리 주소와 페이지 테이블 엔트리의 플래그를 찾는다.
  * 
@@ -6,6 +6,12 @@
 #define PTE_P 0x001
 #define PTE_W 0x002
 #define PTE_U 0x004
+#define PTE_PS 0x080
+
+#define POLICY_PAGES 100 // Test 10에서 쓰는 페이지 수 (TLB 64 엔트리보다 많게)
+#define HUGE_SIZE (4 * 1024 * 1024) // Test 11의 큰 페이지 크기
+#define HUGE_PAGES (HUGE_SIZE / 4096)
+#define HUGE_STEP 64                // Test 11에서 확인하는 페이지 간격
 
 // 테스트 1: 다양한 권한 조합 검증
 void test_permission_flags(void)
@@ -592,6 +598,329 @@ void test_permission_different_flags(void) {
 	printf(1, "\n=== Test Complete ===\n");
 }
 
+// 테스트 7: fork 시 자식 매핑의 IPT 일괄 등록
+void test_fork_ipt_clone(void)
+{
+	char *p;
+	int pid, i, j, count, found, missing;
+	uint pa, flags;
+	struct vlist buffer[10];
+
+	printf(1, "\n========================================\n");
+	printf(1, "Test 7: fork 시 자식 매핑 IPT 등록\n");
+	printf(1, "========================================\n");
+
+	p = sbrk(4 * 4096);
+	if (p == (char*)-1) {
+		printf(2, "sbrk failed\n");
+		return;
+	}
+	for (i = 0; i < 4; i++)
+		p[i * 4096] = 'A' + i;
+
+	pid = fork();
+	if (pid == 0) {
+		// 자식은 sbrk 없이 바로 자기 물리 페이지를 IPT에서 찾을 수 있어야 한다.
+		missing = 0;
+		for (i = 0; i < 4; i++) {
+			if (vtop(p + i * 4096, &pa, &flags) < 0) {
+				missing++;
+				continue;
+			}
+			count = phys2virt(pa, buffer, 10);
+			found = 0;
+			for (j = 0; j < count; j++)
+				if (buffer[j].pid == getpid() && buffer[j].va == (uint)p + i * 4096)
+					found = 1;
+			if (!found)
+				missing++;
+		}
+		if (missing == 0)
+			printf(1, "[PASS] Child mappings registered in IPT at fork\n");
+		else
+			printf(1, "[FAIL] %d child pages missing from IPT\n", missing);
+		exit();
+	}
+	wait();
+	sbrk(-4 * 4096);
+}
+
+// 테스트 8: 물리 주소 범위를 작은 버퍼로 나누어 조회
+void test_phys_range(void)
+{
+	char *p;
+	int i, j, n, total, missing, sorted;
+	uint pa[8], flags, lo, hi;
+	struct pvlist buffer[4];
+	struct prange r;
+
+	printf(1, "\n========================================\n");
+	printf(1, "Test 8: 물리 주소 범위 조회\n");
+	printf(1, "========================================\n");
+
+	p = sbrk(8 * 4096);
+	if (p == (char*)-1) {
+		printf(2, "sbrk failed\n");
+		return;
+	}
+
+	// 각 페이지의 물리 주소와 전체 범위를 구한다.
+	lo = 0xFFFFFFFF;
+	hi = 0;
+	for (i = 0; i < 8; i++) {
+		p[i * 4096] = 'a' + i;
+		vtop(p + i * 4096, &pa[i], &flags);
+		pa[i] &= ~0xFFF;
+		if (pa[i] < lo) lo = pa[i];
+		if (pa[i] > hi) hi = pa[i];
+	}
+
+	// 일부러 작은 버퍼로 여러 번 나누어 조회한다.
+	r.pa = lo;
+	r.pa_end = hi + 4096;
+	r.after = 0;
+	missing = 8;
+	sorted = 1;
+	total = 0;
+	uint last = 0;
+	while (r.pa < r.pa_end) {
+		if ((n = phys2virt_range(&r, buffer, 4)) < 0) {
+			printf(1, "[FAIL] phys2virt_range failed\n");
+			sbrk(-8 * 4096);
+			return;
+		}
+		for (j = 0; j < n; j++) {
+			if (buffer[j].pfn < last)
+				sorted = 0;
+			last = buffer[j].pfn;
+			for (i = 0; i < 8; i++)
+				if (buffer[j].pfn == pa[i] / 4096 && buffer[j].pid == getpid() &&
+				    buffer[j].va == (uint)p + i * 4096)
+					missing--;
+		}
+		total += n;
+	}
+	printf(1, "  Range 0x%x-0x%x: %d mappings\n", lo, hi + 4096, total);
+
+	if (missing == 0 && sorted)
+		printf(1, "[PASS] All pages found in ascending pfn order\n");
+	else
+		printf(1, "[FAIL] missing=%d sorted=%d\n", missing, sorted);
+
+	sbrk(-8 * 4096);
+}
+
+/**
+ * @brief 필터를 건 ipt_export()로 받은 매핑 수를 센다.
+ */
+static int
+count_export(int pid, int flags)
+{
+	struct pvlist buffer[64];
+	struct ipt_export c;
+	int n, total = 0;
+
+	memset(&c, 0, sizeof(c));
+	c.pid = pid;
+	c.flags = flags;
+	while (!c.done) {
+		if ((n = ipt_export(&c, buffer, 64)) < 0)
+			return -1;
+		total += n;
+	}
+	return total;
+}
+
+// 테스트 9: 필터를 건 IPT 전체 내보내기
+void test_ipt_export(void)
+{
+	int pages, all, user;
+
+	printf(1, "\n========================================\n");
+	printf(1, "Test 9: IPT 전체 내보내기\n");
+	printf(1, "========================================\n");
+
+	// exec 이후 0 ~ sz 의 모든 페이지가 이 PID로 등록되어 있다.
+	// 그중 스택 가드 페이지 하나만 PTE_U가 꺼져 있다.
+	pages = ((uint)sbrk(0) + 4095) / 4096;
+	all = count_export(getpid(), 0);
+	user = count_export(getpid(), 0x4);
+	printf(1, "  pages=%d exported=%d user=%d\n", pages, all, user);
+
+	if (all == pages && user == pages - 1)
+		printf(1, "[PASS] Export matches process image\n");
+	else
+		printf(1, "[FAIL] Export does not match process image\n");
+}
+
+// 테스트 10: 모든 TLB 교체 정책에서 vtop 결과가 같은지 검증
+void test_tlb_policies(void)
+{
+	static char *names[TLB_POLICY_NUM] = { "plru", "lru", "fifo", "random", "clock", "direct" };
+	uint pa[POLICY_PAGES], got, flags;
+	char *base;
+	int pol, old, i, r, ok;
+
+	printf(1, "\n========================================\n");
+	printf(1, "Test 10: TLB 교체 정책별 변환 결과\n");
+	printf(1, "========================================\n");
+
+	// TLB보다 많은 페이지를 만들어 교체가 일어나게 한다.
+	base = sbrk(POLICY_PAGES * 4096);
+	if (base == (char*)-1) {
+		printf(2, "sbrk failed\n");
+		return;
+	}
+	for (i = 0; i < POLICY_PAGES; i++) {
+		base[i * 4096] = (char)i;
+		vtop(base + i * 4096, &pa[i], &flags);
+	}
+
+	old = tlb_ctl(TLB_CTL_POLICY, -1);
+	for (pol = 0; pol < TLB_POLICY_NUM; pol++) {
+		tlb_ctl(TLB_CTL_POLICY, pol);
+		ok = 1;
+		// 같은 페이지를 여러 번 섞어서 조회해 히트와 교체를 모두 거친다.
+		for (r = 0; r < 3; r++) {
+			for (i = 0; i < POLICY_PAGES; i++) {
+				int p = (i * 7 + r) % POLICY_PAGES;
+				if (vtop(base + p * 4096, &got, &flags) < 0 || got != pa[p])
+					ok = 0;
+			}
+		}
+		if (ok)
+			printf(1, "[PASS] %s: all translations match\n", names[pol]);
+		else
+			printf(1, "[FAIL] %s: translation mismatch\n", names[pol]);
+	}
+	if (tlb_ctl(TLB_CTL_POLICY, old) != TLB_POLICY_NUM - 1)
+		printf(1, "[FAIL] tlb_ctl did not return previous policy\n");
+
+	sbrk(-POLICY_PAGES * 4096);
+}
+
+/**
+ * @brief 큰 페이지 안의 한 페이지를 확인한다. 내용이 쓴 값 그대로이고, pa0이 0이 아니면 pa0부터 연속된 프레임에 있으며,
+ *        IPT에 이 PID로 PTE_PS 없이 등록되어 있어야 한다. IPT 조회 결과는 큰 페이지 안의 buf로 받는다. (copyout이 큰 페이지를 거친다.)
+ * @return 문제가 없으면 0, 있으면 1
+ */
+static int
+huge_check_page(char *base, int i, uint pa0, struct vlist *buf)
+{
+	uint pa, flags;
+	int j, n, found = 0;
+
+	if (base[i * 4096] != (char)(i % 100 + 1))
+		return 1;
+	if (vtop(base + i * 4096, &pa, &flags) < 0)
+		return 1;
+	pa &= ~0xFFF;
+	if (pa0 && pa != pa0 + i * 4096)
+		return 1;
+	n = phys2virt(pa, buf, 8);
+	for (j = 0; j < n; j++)
+		if (buf[j].pid == getpid() && buf[j].va == (uint)base + i * 4096 &&
+		    (buf[j].flags & PTE_PS) == 0)
+			found = 1;
+	return !found;
+}
+
+/**
+ * @brief 큰 페이지의 앞 npages 페이지를 HUGE_STEP 간격과 마지막 페이지로 확인한다.
+ * @return 문제가 있는 페이지 수
+ */
+static int
+huge_check(char *base, int npages, uint pa0, struct vlist *buf)
+{
+	int i, bad = 0;
+
+	for (i = 0; i < npages; i += HUGE_STEP)
+		bad += huge_check_page(base, i, pa0, buf);
+	bad += huge_check_page(base, npages - 1, pa0, buf);
+	return bad;
+}
+
+/**
+ * @brief fork한 자식이 큰 페이지 구간을 자기 프레임으로 복사받았는지 확인한다.
+ */
+static void
+huge_fork_check(char *base, int npages, uint pa0, struct vlist *buf, char *label)
+{
+	uint pa, flags;
+	int bad;
+
+	if (fork() == 0) {
+		bad = huge_check(base, npages, 0, buf);
+		if (vtop(base, &pa, &flags) < 0 || (pa & ~0xFFF) == pa0)
+			bad++;
+		if (bad == 0)
+			printf(1, "[PASS] %s: child has its own copy\n", label);
+		else
+			printf(1, "[FAIL] %s: %d child pages wrong\n", label, bad);
+		exit();
+	}
+	wait();
+}
+
+// 테스트 11: 4MB 큰 페이지 (정렬된 sbrk 확장, 한 페이지 축소, fork)
+void test_huge_pages(void)
+{
+	char *base;
+	uint cur, pad, pa0, flags, size = HUGE_SIZE;
+	struct vlist *buf;
+	int old, i, bad;
+
+	printf(1, "\n========================================\n");
+	printf(1, "Test 11: 4MB 큰 페이지\n");
+	printf(1, "========================================\n");
+
+	// 4MB 경계까지 채운 뒤 4MB를 한 번에 늘려 큰 페이지로 매핑되게 한다.
+	old = tlb_ctl(TLB_CTL_HUGE, 1);
+	cur = (uint)sbrk(0);
+	pad = (HUGE_SIZE - cur % HUGE_SIZE) % HUGE_SIZE;
+	if (sbrk(pad) == (char*)-1 || (base = sbrk(HUGE_SIZE)) == (char*)-1) {
+		printf(2, "sbrk failed\n");
+		tlb_ctl(TLB_CTL_HUGE, old);
+		return;
+	}
+	for (i = 0; i < HUGE_PAGES; i++)
+		base[i * 4096] = i % 100 + 1;
+	buf = (struct vlist*)(base + 4096 + 16);
+
+	// 연속 물리 구간을 얻지 못해 4KB 페이지로 대신했으면 연속성은 확인하지 않는다.
+	vtop(base, &pa0, &flags);
+	pa0 &= ~0xFFF;
+	if (pa0 % HUGE_SIZE != 0) {
+		printf(1, "[INFO] No free 4MB region, mapped with 4KB pages\n");
+		pa0 = 0;
+	}
+
+	bad = huge_check(base, HUGE_PAGES, pa0, buf);
+	if (bad == 0)
+		printf(1, "[PASS] 4MB growth: translation, contents and IPT match\n");
+	else
+		printf(1, "[FAIL] 4MB growth: %d pages wrong\n", bad);
+	huge_fork_check(base, HUGE_PAGES, pa0, buf, "fork of 4MB mapping");
+
+	// 한 페이지를 줄이면 큰 페이지가 쪼개지고 나머지는 같은 프레임에 남아야 한다.
+	if (sbrk(-4096) == (char*)-1) {
+		printf(1, "[FAIL] sbrk shrink failed\n");
+	} else {
+		size -= 4096;
+		bad = huge_check(base, HUGE_PAGES - 1, pa0, buf);
+		if (vtop(base + (HUGE_PAGES - 1) * 4096, &cur, &flags) >= 0)
+			bad++;
+		if (bad == 0)
+			printf(1, "[PASS] Partial shrink: remaining pages kept, last page gone\n");
+		else
+			printf(1, "[FAIL] Partial shrink: %d pages wrong\n", bad);
+		huge_fork_check(base, HUGE_PAGES - 1, pa0, buf, "fork after split");
+	}
+
+	sbrk(-size - pad);
+	tlb_ctl(TLB_CTL_HUGE, old);
+}
+
 int main(void)
 {
 	int start_ticks = uptime();
@@ -612,6 +941,16 @@ int main(void)
 
 	test_permission_different_flags();
 
+	test_fork_ipt_clone();
+
+	test_phys_range();
+
+	test_ipt_export();
+
+	test_tlb_policies();
+
+	test_huge_pages();
+
 	printf(1, "\n");
 	printf(1, "========================================\n");
 	printf(1, "	 All Tests Complete\n");
@@ -0,0 +1,172 @@
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define MAX_TLBSTAT 128
+
+static void
+usage(void)
+{
+    printf(1, "usage: tlbstat [-p PID] [-z] [-c] [-m CLASS L1MASK L2MASK]\n");
+    exit();
+}
+
+/**
+ * @brief 히트율을 소수점 한 자리 퍼센트로 출력한다.
+ */
+static void
+print_rate(uint hits, uint misses)
+{
+    uint total = hits + misses;
+    uint x10 = total ? hits * 1000 / total : 0;
+
+    printf(1, "%d.%d%%", x10 / 10, x10 % 10);
+}
+
+/**
+ * @brief 10진수 또는 0x로 시작하는 16진수 way 마스크를 읽는다.
+ */
+static uint
+parse_mask(char *s)
+{
+    uint v = 0;
+    int d;
+
+    if (s[0] != '0' || (s[1] != 'x' && s[1] != 'X'))
+        return atoi(s);
+    for (s += 2; *s; s++) {
+        if (*s >= '0' && *s <= '9')
+            d = *s - '0';
+        else if (*s >= 'a' && *s <= 'f')
+            d = *s - 'a' + 10;
+        else if (*s >= 'A' && *s <= 'F')
+            d = *s - 'A' + 10;
+        else
+            return 0;
+        v = v * 16 + d;
+    }
+    return v;
+}
+
+/**
+ * @brief tlb_part() 시스템 콜로 분할 클래스별 way 마스크와 히트율을 출력한다.
+ */
+static void
+print_parts(struct tlb_part *parts)
+{
+    printf(1, "[class]\t[L1]\t[L2]\t[hit]\t[miss]\t[rate]\n");
+    for (int i = 0; i < TLB_CLASS_NUM; i++) {
+        printf(1, "%d\t0x%x\t0x%x\t%d\t%d\t", i, parts[i].l1_mask, parts[i].l2_mask,
+            parts[i].hits, parts[i].misses);
+        print_rate(parts[i].hits, parts[i].misses);
+        printf(1, "\n");
+    }
+}
+
+/**
+ * @brief tlb_stat() 시스템 콜로 PID별 SW TLB 통계를 표 형태로 출력한다.
+ * @param -p <PID> : 특정 PID의 통계만 출력한다.
+ * @param -z : 출력 후 TLB 통계를 초기화한다.
+ * @param -c : PID별 통계 대신 분할 클래스별 way 마스크와 히트율을 출력한다.
+ * @param -m <CLASS> <L1MASK> <L2MASK> : 클래스가 채울 수 있는 L1/L2 way 마스크를 바꾸고 클래스 표를 출력한다.
+ *
+ * @return
+ */
+int main(int argc, char *argv[])
+{
+    static struct tlb_stat buf[MAX_TLBSTAT];
+    struct tlb_part parts[TLB_CLASS_NUM];
+
+    //0. 옵션 처리 변수 할당
+    int pid = 0;
+    int reset = 0;
+    int classes = 0;
+    int cls = -1;
+    uint l1_mask = 0, l2_mask = 0;
+    int n, shown = 0;
+
+    //1. 옵션 파싱
+    for(int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-p")) {
+            if (i + 1 >= argc) {
+                usage();
+            }
+            i++;
+            pid = atoi(argv[i]);
+            if (pid <= 0) {
+                usage();
+            }
+        }
+        else if (!strcmp(argv[i], "-z")) {
+            reset = 1;
+        }
+        else if (!strcmp(argv[i], "-c")) {
+            classes = 1;
+        }
+        else if (!strcmp(argv[i], "-m")) {
+            if (i + 3 >= argc) {
+                usage();
+            }
+            cls = atoi(argv[i + 1]);
+            l1_mask = parse_mask(argv[i + 2]);
+            l2_mask = parse_mask(argv[i + 3]);
+            i += 3;
+            if (cls < 0 || cls >= TLB_CLASS_NUM) {
+                usage();
+            }
+            classes = 1;
+        }
+        else {
+            usage();
+        }
+    }
+
+    //2. 분할 클래스: 마스크를 바꿀 때는 현재 표를 읽어 한 클래스만 고쳐 쓴다.
+    if (classes) {
+        if (tlb_part(parts, 0) < 0) {
+            printf(1, "tlbstat: tlb_part failed\n");
+            exit();
+        }
+        if (cls >= 0) {
+            parts[cls].l1_mask = l1_mask;
+            parts[cls].l2_mask = l2_mask;
+            if (tlb_part(parts, 1) < 0) {
+                printf(1, "tlbstat: invalid way mask\n");
+                exit();
+            }
+        }
+        print_parts(parts);
+        if (reset)
+            tlb_ctl(TLB_CTL_RESET_STATS, 0);
+        exit();
+    }
+
+    //3. 통계 조회
+    n = tlb_stat(buf, MAX_TLBSTAT);
+    if (n < 0) {
+        printf(1, "tlbstat: tlb_stat failed\n");
+        exit();
+    }
+
+    //4. 출력 (pid 0은 커널 문맥에서의 변환)
+    printf(1, "[pid]\t[hit]\t[miss]\t[rate]\t[cold]\t[confl]\t[capac]\t[evictd]\t[self]\t[evicts]\t[inval]\t[by]\n");
+    for (int i = 0; i < n; i++) {
+        struct tlb_stat *s = &buf[i];
+
+        if (pid && s->pid != pid)
+            continue;
+        printf(1, "%d\t%d\t%d\t", s->pid, s->hits, s->misses);
+        print_rate(s->hits, s->misses);
+        printf(1, "\t%d\t%d\t%d\t%d\t\t%d\t%d\t\t%d\t%d\n",
+            s->cold, s->conflict, s->capacity, s->evicted, s->self_evicted,
+            s->evicts, s->invalidated, s->last_evictor);
+        shown++;
+    }
+    printf(1, "[tlbstat] %d processes\n", shown);
+
+    //5. 초기화
+    if (reset)
+        tlb_ctl(TLB_CTL_RESET_STATS, 0);
+
+    exit();
+}
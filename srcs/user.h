@@ -21,8 +21,133 @@ struct vlist {
 	ushort flags;
 };
 
+/**
+ * @brief phys2virt_range()가 돌려주는 매핑 하나
+ */
+struct pvlist {
+	uint pfn;      // 물리 프레임 번호
+	uint pid;
+	uint va;
+	ushort flags;
+	ushort refcnt;
+};
+
+/**
+ * @brief phys2virt_range()의 조회 위치. 호출할 때마다 다음 위치로 갱신된다.
+ */
+struct prange {
+	uint pa;       // 다음에 조회할 물리 주소
+	uint pa_end;   // 조회 끝 (포함하지 않음)
+	uint after;    // 처음 호출할 때는 0
+	uint last_pid; // pa 프레임에서 마지막으로 본 매핑 (after가 1일 때만 쓰인다)
+	uint last_va;
+};
+
+/**
+ * @brief ipt_export()의 커서와 필터. 호출할 때마다 pfn, after, last_pid, last_va, done이 갱신된다.
+ */
+struct ipt_export {
+	uint pfn;      // 처음 호출할 때는 0
+	uint after;    // 처음 호출할 때는 0
+	uint last_pid; // pfn 프레임에서 마지막으로 본 매핑 (after가 1일 때만 쓰인다)
+	uint last_va;
+	uint pid;    // 0이 아니면 이 PID의 엔트리만
+	uint shared; // 1이면 refcnt > 1 인 엔트리만
+	uint flags;  // 이 플래그 비트가 모두 켜진 엔트리만
+	uint done;   // 끝까지 읽었으면 1
+};
+
 #define PFNNUM 60000
 
+//ipt_ctl() 명령
+#define IPT_CTL_TRACK 1
+#define IPT_CTL_RESET_STATS 2
+#define IPT_CTL_DEFER 3
+#define IPT_CTL_VTOP 4
+
+//tlb_ctl() 명령
+#define TLB_CTL_POLICY 1
+#define TLB_CTL_RESET_STATS 2
+#define TLB_CTL_VICTIM 3
+#define TLB_CTL_L2 4
+#define TLB_CTL_PRIVATE 5
+#define TLB_CTL_PREFETCH 6
+#define TLB_CTL_SIZE 7
+#define TLB_CTL_AUTOSIZE 8
+#define TLB_CTL_L2_SEQ 9
+#define TLB_CTL_KCOPY 10
+#define TLB_CTL_FORK_WARM 11
+#define TLB_CTL_CLASS 12
+#define TLB_CTL_HUGE 13
+
+#define TLB_CLASS_NUM 4 // TLB 분할 클래스 수 (tlb_part() 배열 크기)
+
+//L2 TLB 동작 방식 (TLB_CTL_L2 인자)
+#define TLB_L2_OFF 0
+#define TLB_L2_INCLUSIVE 1
+#define TLB_L2_EXCLUSIVE 2
+
+//SW TLB 교체 정책 (TLB_CTL_POLICY 인자)
+#define TLB_POLICY_PLRU 0
+#define TLB_POLICY_LRU 1
+#define TLB_POLICY_FIFO 2
+#define TLB_POLICY_RANDOM 3
+#define TLB_POLICY_CLOCK 4
+#define TLB_POLICY_DIRECT 5
+#define TLB_POLICY_NUM 6
+
+#define IPT_HIST_BINS 8
+
+/**
+ * @brief tlb_stat()이 돌려주는 PID별 TLB 통계
+ */
+struct tlb_stat {
+	uint pid;
+	uint hits;         // 히트 (L1, victim, L2, 전용 TLB)
+	uint misses;       // 미스
+	uint cold;         // 미스 중 처음 보거나 기억 범위 밖의 키
+	uint conflict;     // 미스 중 다른 set에 빈 자리가 있는데 자기 set에서 밀려났던 키
+	uint capacity;     // 미스 중 TLB 전체가 가득 차서 밀려났던 키
+	uint evicted;      // 다른 PID가 밀어낸 이 PID의 엔트리 수
+	uint self_evicted; // 이 PID가 밀어낸 자기 엔트리 수
+	uint evicts;       // 이 PID가 밀어낸 다른 PID의 엔트리 수
+	uint invalidated;  // 무효화로 지워진 이 PID의 엔트리 수
+	uint last_evictor; // 마지막으로 이 PID의 엔트리를 밀어낸 PID
+};
+
+/**
+ * @brief tlb_part()이 주고받는 클래스별 TLB 분할 설정과 통계
+ */
+struct tlb_part {
+	uint l1_mask;  // L1 set에서 채울 수 있는 way 마스크
+	uint l2_mask;  // L2 set에서 채울 수 있는 way 마스크
+	uint hits;     // 이 클래스 프로세스의 히트 (L1, victim, L2, 전용 TLB)
+	uint misses;   // 이 클래스 프로세스의 미스
+};
+
+/**
+ * @brief ipt_stat()이 돌려주는 IPT 통계
+ */
+struct ipt_stat {
+	uint entries;                   // 엔트리 수
+	uint buckets;                   // 버킷 수
+	uint used_buckets;              // 비어 있지 않은 버킷 수
+	uint max_chain;                 // 가장 긴 체인 길이
+	uint chain_hist[IPT_HIST_BINS]; // 체인 길이 0,1,2,3,4,5-8,9-16,17+ 인 버킷 수
+	uint lookups;                   // 체인 조회 횟수
+	uint probes;                    // 조회 중 비교한 엔트리 수 합계
+	uint avg_probes_x100;           // 조회당 평균 비교 횟수 x 100
+	uint dup_bumps;                 // 중복 삽입으로 refcnt만 올린 횟수
+	uint operations;                // 변경 연산 횟수
+	uint lock_acquires;             // ipt_lock 획득 횟수
+	uint lock_contended;            // 기다려야 했던 락 획득 횟수
+	uint lock_wait_kcycles;         // 락 대기 시간 (1024 사이클 단위)
+	uint resizing;                  // 크기 변경 진행 중이면 1
+	uint deferred;                  // 지연 모드이면 1
+	uint log_drains;                // 변경 로그를 일괄 반영한 횟수
+	uint log_applied;               // 반영한 변경 로그 기록 수
+};
+
 // system calls
 int fork(void);
 int exit(void) __attribute__((noreturn));
@@ -52,6 +177,13 @@ int vtop(void *va, uint *pa_out, uint *flags_out);
 int phys2virt(uint pa_page, struct vlist *out, int max);
 int setpageflags(uint addr, int flags);
 int print_ipt_status(void);
+int ipt_ctl(int cmd, int arg);
+int ipt_stat(struct ipt_stat *st);
+int phys2virt_range(struct prange *r, struct pvlist *out, int max);
+int ipt_export(struct ipt_export *c, struct pvlist *out, int max);
+int tlb_ctl(int cmd, int arg);
+int tlb_stat(struct tlb_stat *out, int max);
+int tlb_part(struct tlb_part *parts, int set);
 
 // ulib.c
 int stat(const char*, struct stat*);
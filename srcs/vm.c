@@ -11,249 +11,3063 @@
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
 
+/**
+ * @brief 사이클 카운터(TSC)를 읽는다. 통계 측정용.
+ */
+static inline unsigned long long
+rdtsc(void)
+{
+  uint lo, hi;
+  asm volatile("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long)hi << 32) | lo;
+}
+
 /**
  * @struct TLB에 사용하는 엔트리 구조체
  * @brief  TLB에 사용되는 엔트리 구조체이며 캐싱을 구현하기 위한 데이터를 담고 있다.
  */
-struct sw_tlb_entry {
-  uint pid;     //프로세스 id
-  uint va_page; //가상 페이지 번호 (va >> 12)
-  uint pa_page; //물리 페이지 번호 (pa >> 12)
-  uint flags;   //PTE 플래그
-  int valid;    //유효 비트
-};
+struct sw_tlb_entry {
+  uint tag;     //주소 공간 태그 (세대 << 8 | ASID)
+  uint va_page; //가상 페이지 번호 (va >> 12)
+  uint pa_page; //물리 페이지 번호 (pa >> 12)
+  uint flags;   //PTE 플래그
+  int valid;    //유효 비트
+  uint age;     //교체 정책용 (LRU/FIFO는 시각, CLOCK은 참조 비트)
+  ushort prefetched; //선반입으로 채워졌고 아직 히트가 없으면 1
+  ushort cls;   //엔트리를 채운 프로세스의 분할 클래스 (L2로 내려갈 때 이 클래스의 way 마스크를 쓴다.)
+  uint pid;     //엔트리를 채운 프로세스 (통계용)
+};
+
+#define SW_TLB_SIZE 64 //CPU별 TLB 캐시 기본 크기 (실행 중에 tlb_ctl()로 바꿀 수 있다.)
+#ifndef SW_TLB_WAYS
+#define SW_TLB_WAYS 4  //set당 way 수 (2의 거듭제곱, 1이면 Direct-mapped)
+#endif
+//tree-PLRU는 way 수가 2의 거듭제곱이어야 하고, 노드 비트(1 ~ SW_TLB_WAYS-1)가 set별 상태 uint 하나에 들어가야 한다.
+typedef char sw_tlb_ways_check[(SW_TLB_WAYS >= 1 && SW_TLB_WAYS <= 32 &&
+                                (SW_TLB_WAYS & (SW_TLB_WAYS - 1)) == 0) ? 1 : -1];
+#define SW_TLB_SETS (SW_TLB_SIZE / SW_TLB_WAYS) //기본 set 수
+#define SW_TLB_SETS_PER_PAGE (PGSIZE / (SW_TLB_WAYS * sizeof(struct sw_tlb_entry))) //페이지 하나에 담기는 set 수
+#define SW_TLB_MAX_PAGES 4                     //CPU별 TLB에 쓸 수 있는 최대 페이지 수
+#define SW_TLB_MIN_SETS 4                      //크기를 줄일 수 있는 최소 set 수
+#define SW_TLB_MAX_SETS (SW_TLB_SETS_PER_PAGE * SW_TLB_MAX_PAGES) //크기를 키울 수 있는 최대 set 수
+#define SW_TLB_AUTO_WINDOW 100                 //크기 조절기가 미스율을 재는 구간 (tick)
+#define SW_TLB_AUTO_MIN_LOOKUPS 1000           //구간의 조회 수가 이보다 적으면 크기를 바꾸지 않는다.
+#define SW_TLB_AUTO_GROW 100                   //구간의 L1 미스율(천분율)이 이보다 높으면 두 배로 키운다.
+#define SW_TLB_AUTO_SHRINK 20                  //구간의 L1 미스율(천분율)이 이보다 낮으면 반으로 줄인다.
+#define SW_TLB_AUTO_GAIN 25                    //키운 뒤 미스율이 이 비율(%)만큼 줄지 않았으면 되돌린다.
+#define SW_TLB_AUTO_HOLD 10                    //되돌린 뒤 다시 키우지 않을 구간 수
+#define SW_TLB_VICTIM 8                        //CPU별 victim buffer 엔트리 수
+#define SW_TLB_PF_MAX 8                        //TLB 미스 때 선반입할 최대 페이지 수 기본값
+#define SW_TLB_WARM_MAX 32                     //fork 때 자식 TLB에 미리 채울 최대 엔트리 수
+#define SW_TLB_HUGE 8                          //CPU별 4MB 큰 페이지 TLB 엔트리 수 (fully-associative)
+#define HUGEPGSIZE (PGSIZE * NPTENTRIES)       //PSE 큰 페이지 크기 (PDE 하나가 매핑하는 4MB)
+#define SW_TLB_PSTAT 64                        //CPU별 PID 통계 슬롯 수 (pid % 64, 겹치면 새 PID가 차지한다.)
+#define SW_TLB_SHADOW 64                       //미스 분류를 위해 CPU마다 기억하는 최근 교체된 키 수
+#define SW_TLB_L2_SIZE 512                      //공유 L2 TLB 엔트리 수
+#define SW_TLB_L2_WAYS 8                        //L2 set당 way 수
+#define SW_TLB_L2_SETS (SW_TLB_L2_SIZE / SW_TLB_L2_WAYS) //L2 set 수
+#define SW_TLB_RANGE_SWEEP (sw_tlb_size.nsets)   //이 페이지 수 이상이면 범위 무효화를 전체 훑기로 처리한다.
+#define SW_TLB_ASID_BITS 8                      //태그 하위의 ASID 비트 수
+#define SW_TLB_ASID_MAX (1 << SW_TLB_ASID_BITS) //세대 하나에서 나눠줄 수 있는 ASID 수 (0 제외)
+#define SW_TLB_GEN_MAX (1 << (32 - SW_TLB_ASID_BITS)) //세대 번호 범위
+
+//TLB 교체 정책 (tlb_ctl()의 TLB_CTL_POLICY 인자)
+#define TLB_POLICY_PLRU 0   //tree-PLRU (기본)
+#define TLB_POLICY_LRU 1    //사용 시각이 가장 오래된 way
+#define TLB_POLICY_FIFO 2   //삽입 시각이 가장 오래된 way
+#define TLB_POLICY_RANDOM 3 //무작위 way
+#define TLB_POLICY_CLOCK 4  //참조 비트가 꺼진 way를 시계 바늘 순서로 (second chance)
+#define TLB_POLICY_DIRECT 5 //키마다 way 하나로 고정 (Direct-mapped)
+#define TLB_POLICY_NUM 6
+
+//tlb_ctl() 명령
+#define TLB_CTL_POLICY 1      //교체 정책 변경 (모든 TLB를 비우고 통계 초기화)
+#define TLB_CTL_RESET_STATS 2 //히트/미스 통계 초기화
+#define TLB_CTL_VICTIM 3      //victim buffer 사용 여부 설정
+#define TLB_CTL_L2 4          //L2 TLB 동작 방식 설정 (TLB_L2_*)
+#define TLB_CTL_PRIVATE 5     //공유 TLB 대신 프로세스 전용 TLB를 쓸지 설정
+#define TLB_CTL_PREFETCH 6    //TLB 미스 때 선반입할 최대 페이지 수 설정 (0이면 끔)
+#define TLB_CTL_SIZE 7        //CPU별 L1 TLB 엔트리 수 설정
+#define TLB_CTL_AUTOSIZE 8    //미스율에 따른 L1 TLB 크기 자동 조절 여부 설정
+#define TLB_CTL_L2_SEQ 9      //L2 조회를 락 없이 순번으로 검증할지 설정
+#define TLB_CTL_KCOPY 10      //uva2ka(copyout)의 주소 변환에 TLB를 쓸지 설정
+#define TLB_CTL_FORK_WARM 11  //fork 때 부모의 뜨거운 페이지로 자식 TLB를 미리 채울지 설정
+#define TLB_CTL_CLASS 12      //현재 프로세스의 TLB 분할 클래스 설정 (자식이 물려받는다.)
+#define TLB_CTL_HUGE 13       //allocuvm이 4MB 큰 페이지로 매핑할지 설정
+
+#define TLB_CLASS_NUM 4       //TLB 분할 클래스 수 (tlb_part()의 배열 크기)
+//way 수가 32이면 int 시프트가 정의되지 않으므로 64비트로 시프트한 뒤 uint로 자른다.
+#define SW_TLB_WAY_ALL ((uint)((1ULL << SW_TLB_WAYS) - 1))       //L1 set의 모든 way 마스크
+#define SW_TLB_L2_WAY_ALL ((uint)((1ULL << SW_TLB_L2_WAYS) - 1)) //L2 set의 모든 way 마스크
+typedef char sw_tlb_l2_ways_check[(SW_TLB_L2_WAYS >= 1 && SW_TLB_L2_WAYS <= 32) ? 1 : -1]; //way 마스크가 uint 하나에 들어가야 한다.
+
+//L2 TLB 동작 방식
+#define TLB_L2_OFF 0          //L2를 쓰지 않는다.
+#define TLB_L2_INCLUSIVE 1    //페이지 순회 결과를 L1, L2 모두에 채운다.
+#define TLB_L2_EXCLUSIVE 2    //L1에서 밀려난 엔트리만 L2로 내려가고, L2 히트는 L1으로 옮겨 온다.
+
+/**
+ * @struct N-way set-associative TLB 캐시를 구현한 구조체 (CPU마다 하나)
+ *
+ * (tag, va_page)로 set을 고르고 set 안의 way를 모두 비교한다.
+ * 교체할 way는 sw_tlb_policies[]의 정책이 set별 상태(state)와 엔트리의 age로 고른다.
+ * 조회는 정책과 상관없이 set의 모든 way를 비교하므로, 정책은 적중률에만 영향을 주고 정확성과는 무관하다.
+ * set에서 밀려난 엔트리는 작은 fully-associative victim buffer가 받아 두었다가,
+ * set 미스 때 찾으면 set으로 되돌린다. (같은 set에 몰리는 충돌 미스를 흡수한다.)
+ *
+ * set 배열은 kalloc한 페이지에 두고 실행 중에 크기(set 수)를 바꿀 수 있다. (sw_tlb_size 참고)
+ * 4MB 큰 페이지(PSE) 매핑은 set에 넣지 않고, 실제 TLB처럼 따로 둔 작은 fully-associative 배열(huge)에 하나씩 넣는다.
+ *
+ * 실제 TLB처럼 CPU마다 따로 두고, 조회/삽입은 인터럽트를 끈 채 자기 CPU의 TLB만 건드리므로 락이 없다.
+ * 다른 CPU의 TLB는 무효화할 때만 valid를 0으로 쓴다. 무효화 대상 PID는 지금 이 CPU에서 돌고 있거나
+ * 이미 종료된 프로세스이고, xv6에서 한 프로세스는 한 번에 한 CPU에서만 돌므로 다른 CPU가 그 PID의
+ * 엔트리를 동시에 다시 채우는 일은 없다. (다른 키로 덮어쓰는 중인 엔트리를 지우면 미스가 한 번 늘 뿐이다.)
+ */
+struct sw_tlb{
+  struct sw_tlb_entry *pages[SW_TLB_MAX_PAGES];          //캐시 set 배열 (페이지마다 SW_TLB_SETS_PER_PAGE개 set)
+  uint nsets;                                            //현재 set 수 (2의 거듭제곱)
+  uint size_gen;                                         //마지막으로 맞춘 sw_tlb_size.gen
+  uint state[SW_TLB_MAX_SETS];                           //set별 정책 상태 (tree-PLRU 비트, CLOCK 바늘)
+  uint tick;                                             //LRU/FIFO 시각
+  uint seed;                                             //RANDOM 난수 상태
+  struct sw_tlb_entry victim[SW_TLB_VICTIM];             //set에서 밀려난 엔트리 (fully-associative)
+  uint victim_next;                                      //다음에 덮어쓸 victim 슬롯 (FIFO)
+  struct sw_tlb_entry huge[SW_TLB_HUGE];                 //4MB 큰 페이지 엔트리 (va_page, pa_page는 4MB로 정렬된 첫 페이지)
+  uint huge_next;                                        //다음에 덮어쓸 큰 페이지 슬롯 (FIFO)
+  uint hits;                                             //히트 카운트 (set)
+  uint huge_hits;                                        //큰 페이지 히트 카운트
+  uint victim_hits;                                      //victim buffer 히트 카운트
+  uint l2_hits;                                          //L2 히트 카운트
+  uint l2_retries;                                       //락 없는 L2 조회가 변경과 겹쳐 다시 읽은 횟수
+  uint kcopy_hits;                                       //커널 복사 경로(uva2ka) 히트 카운트
+  uint kcopy_misses;                                     //커널 복사 경로(uva2ka) 미스 카운트
+  uint warm_filled;                                      //fork 때 자식 TLB에 미리 채운 엔트리 수
+  uint warm_skipped;                                     //빈 자리가 없거나 자식에 매핑이 없어 건너뛴 엔트리 수
+  uint private_hits;                                     //전용 TLB 히트 카운트
+  uint private_misses;                                   //전용 TLB 미스 카운트
+  uint pf_issued;                                        //선반입으로 채운 엔트리 수
+  uint pf_used;                                          //선반입한 엔트리의 첫 히트 수
+  uint misses;                                           //미스 카운트 (L1, victim, L2 모두 미스)
+  uint set_filled;                                       //set의 빈 way를 채운 횟수 (소유 CPU만 쓴다.)
+  uint set_emptied;                                      //무효화로 set의 way를 비운 횟수 (sw_tlb_l2.lock을 잡고 쓴다.)
+} __attribute__((aligned(64))) sw_tlb[NCPU];
+
+/**
+ * @brief CPU별 L1 TLB의 목표 크기와 미스율 기반 크기 조절기 상태
+ *
+ * 크기를 바꾸는 쪽은 목표 set 수와 세대(gen)만 기록하고, 각 CPU는 다음 sw_vtop 때 세대가 바뀐 것을 보고
+ * 새 페이지를 할당해 자기 TLB를 갈아 끼운다. (자기 CPU의 TLB만 바꾸므로 조회 경로에 락이 필요 없다.)
+ * 다른 CPU의 무효화는 sw_tlb_l2.lock을 잡고 엔트리를 훑으므로, 페이지를 갈아 끼울 때도 이 락을 잡는다.
+ * 이전 엔트리는 버린다. (캐시이므로 미스가 늘 뿐이다.)
+ *
+ * 조절기는 SW_TLB_AUTO_WINDOW tick마다 L1(set + victim buffer) 미스율을 보고, 높으면 두 배로 키우고 낮으면 반으로 줄인다.
+ * 키운 다음 구간에 미스율이 충분히 줄지 않았으면 (작업 집합이 TLB보다 훨씬 크거나 순차 스캔이면) 되돌리고
+ * 한동안 다시 키우지 않는다. 메모리와 무효화(전체 훑기) 비용은 적중률이 오를 때만 치른다.
+ */
+struct {
+  volatile uint nsets;  //목표 set 수
+  volatile uint gen;    //목표 크기를 바꿀 때마다 증가
+  int autosize;         //1이면 미스율에 따라 크기를 자동으로 조절한다.
+  volatile uint busy;   //조절기가 도는 중이면 1 (한 CPU만 돌도록 xchg로 잡는다.)
+  uint last;            //현재 구간의 시작 tick
+  uint lookups;         //구간 시작 때의 누적 조회 수
+  uint l1_misses;       //구간 시작 때의 누적 L1 미스 수
+  uint grown_rate;      //직전 구간 끝에 키웠으면 키우기 전 미스율 (천분율), 아니면 0
+  uint hold;            //남은 키우기 금지 구간 수
+  uint resizes;         //크기를 바꾼 횟수
+  uint reverts;         //효과가 없어 되돌린 횟수
+  uint alloc_fails;     //페이지 할당에 실패해 크기를 유지한 횟수
+} sw_tlb_size;
+
+/**
+ * @brief 주소 공간 태그(ASID) 배정 상태
+ *
+ * TLB 엔트리는 PID 대신 프로세스의 태그 (세대 << 8 | ASID)로 구분한다.
+ * 프로세스를 비우는 것은 태그를 0으로 돌려 다음 사용 때 새 태그를 받게 하는 것뿐이고,
+ * 이전 태그의 엔트리는 다시 일치할 일이 없으므로 조회 때 자연스럽게 무시되다가 교체된다.
+ * ASID를 다 쓰면 세대를 올려 모든 프로세스가 새 태그를 받게 하고, 세대 번호까지 한 바퀴 돌면
+ * 그때만 모든 CPU의 TLB를 실제로 비운다.
+ */
+struct {
+  struct spinlock lock; //배정 보호
+  volatile uint gen;    //현재 세대 (1부터)
+  uint next;            //다음에 나눠줄 ASID (1부터)
+} sw_tlb_asid;
+
+int sw_tlb_victim_on = 1; //0이면 victim buffer를 쓰지 않는다.
+
+/**
+ * @brief 모든 CPU가 함께 쓰는 L2 TLB (set-associative, 락 보호)
+ *
+ * CPU별 TLB(L1)와 victim buffer에서 모두 미스가 나면 페이지 순회 전에 찾는다.
+ * inclusive 모드에서도 L2에서 밀려난 엔트리를 L1에서 지우지는 않는다. (엄격한 포함 관계가 아니다.)
+ * 무효화는 항상 두 단계를 모두 지우므로 포함 관계가 깨져도 정확성에는 문제가 없다.
+ * 무효화는 이 락을 잡은 채 L1까지 지우고, L1에서 L2로 내려보낼 때도 이 락 안에서 원본의 valid를 다시 확인하므로
+ * 다른 CPU가 내려보내는 중인 엔트리가 무효화 뒤에 L2에 되살아나지 않는다.
+ * set 안의 교체는 사용 시각(age)이 가장 오래된 way를 고른다.
+ *
+ * 엔트리를 바꾸는 쪽(삽입, 빼내기, 무효화, 플러시)은 락을 잡고 set의 순번(seq)을 홀수로 올린 뒤 바꾸고 다시 짝수로 올린다.
+ * 빼내지 않는 조회(inclusive)는 락 없이 순번을 읽고 set을 복사한 다음 순번이 그대로인지 확인해, 바뀌었으면 다시 읽는다.
+ * 조회가 캐시 라인에 쓰지 않으므로 여러 CPU의 L2 히트가 서로를 기다리지 않는다.
+ */
+struct {
+  struct spinlock lock;
+  struct sw_tlb_entry entries[SW_TLB_L2_SETS][SW_TLB_L2_WAYS];
+  volatile uint seq[SW_TLB_L2_SETS]; //set별 순번 (홀수면 변경 중)
+  uint tick; //LRU 시각
+} sw_tlb_l2;
+
+int sw_tlb_l2_mode = TLB_L2_INCLUSIVE; //L2 TLB 동작 방식 (TLB_L2_*)
+int sw_tlb_l2_seq = 1;                 //0이면 L2 조회도 락을 잡는다. (비교 측정용)
+int sw_tlb_kcopy = 1;                  //0이면 uva2ka(copyout)가 TLB를 거치지 않고 매번 페이지 테이블을 순회한다. (비교 측정용)
+int sw_tlb_fork_warm_on = 1;           //0이면 fork 때 자식 TLB를 미리 채우지 않는다.
+int vm_huge_on = 1;                    //0이면 allocuvm이 4MB 큰 페이지를 쓰지 않는다. (비교 측정용)
+
+/**
+ * @brief 4MB 큰 페이지 매핑 통계 (락 없이 세므로 근사값이다.)
+ */
+struct {
+  uint mapped;    //allocuvm/copyuvm이 큰 페이지로 매핑한 4MB 구간 수
+  uint fallbacks; //연속 물리 페이지가 없어 4KB 페이지로 대신한 4MB 구간 수
+  uint splits;    //일부만 바꾸거나 해제하려고 4KB 페이지로 쪼갠 큰 페이지 수
+  uint freed;     //통째로 해제한 큰 페이지 수
+} vm_huge_stat;
+
+/**
+ * 1이면 sw_vtop이 공유 TLB 계층 대신 struct proc 안의 전용 TLB(ptlb)를 쓴다.
+ * 전용 TLB는 그 프로세스만 읽고 쓰며, 무효화도 그 프로세스의 페이지 테이블을 바꾸는 자기 시스템 콜 안에서만 일어난다.
+ * 한 프로세스는 한 번에 한 CPU에서만 돌므로 락이 필요 없고, 다른 프로세스가 엔트리를 밀어낼 수도 없다.
+ * 모드와 상관없이 VM 경로는 전용 TLB도 무효화하므로 모드를 바꿔도 오래된 엔트리가 남지 않는다.
+ */
+int sw_tlb_private = 0;
+
+int sw_tlb_pf_max = SW_TLB_PF_MAX; //선반입할 최대 페이지 수 (0이면 선반입하지 않는다.)
+
+/**
+ * 분할 클래스별로 set 안에서 채울 수 있는 way 마스크 (way partitioning).
+ * 교체 대상은 자기 클래스의 way에서만 고르므로, 다른 클래스와 겹치지 않게 나눈 way의 엔트리는 다른 클래스가 밀어낼 수 없다.
+ * 조회는 마스크와 상관없이 모든 way를 비교하므로 마스크를 바꿔도 이미 채워진 엔트리는 그대로 쓴다.
+ * 기본값은 모든 클래스가 모든 way를 쓰는 것(분할 없음)이다. 프로세스의 클래스는 struct proc의 tlb_class이다.
+ */
+uint sw_tlb_l1_mask[TLB_CLASS_NUM];
+uint sw_tlb_l2_mask[TLB_CLASS_NUM];
+
+/**
+ * @brief tlb_part()이 주고받는 클래스별 TLB 분할 설정과 통계
+ */
+struct tlb_part {
+  uint l1_mask;  //L1 set에서 채울 수 있는 way 마스크
+  uint l2_mask;  //L2 set에서 채울 수 있는 way 마스크
+  uint hits;     //이 클래스 프로세스의 히트 (L1, victim, L2, 전용 TLB)
+  uint misses;   //이 클래스 프로세스의 미스
+};
+
+/**
+ * @brief tlb_stat()이 돌려주는 PID별 TLB 통계
+ */
+struct tlb_stat {
+  uint pid;
+  uint hits;         //히트 (L1, victim, L2, 전용 TLB)
+  uint misses;       //미스
+  uint cold;         //미스 중 처음 보거나 기억 범위 밖의 키 (무효화 뒤의 미스 포함)
+  uint conflict;     //미스 중 다른 set에 빈 자리가 있는데 자기 set이 가득 차서 밀려났던 키
+  uint capacity;     //미스 중 TLB 전체가 가득 차서 밀려났던 키
+  uint evicted;      //다른 PID가 밀어낸 이 PID의 엔트리 수
+  uint self_evicted; //이 PID가 밀어낸 자기 엔트리 수
+  uint evicts;       //이 PID가 밀어낸 다른 PID의 엔트리 수
+  uint invalidated;  //무효화로 지워진 이 PID의 엔트리 수
+  uint last_evictor; //마지막으로 이 PID의 엔트리를 밀어낸 PID
+};
+
+//교체된 키의 미스 분류
+#define TLB_EVICT_CONFLICT 1
+#define TLB_EVICT_CAPACITY 2
+
+/**
+ * @brief PID별 TLB 통계와 미스 분류 상태 (CPU마다 하나, 락 없음)
+ *
+ * CPU마다 따로 세어 히트 경로가 다른 CPU와 캐시 라인을 공유하지 않게 하고, tlb_stat()이 PID별로 합친다.
+ * 미스를 분류하기 위해 set에서 밀려난 키를 shadow 링에 기억해 두고, 그 키로 다시 미스가 나면
+ * 밀려날 때의 사정(다른 set에 빈 자리가 있었는지)에 따라 conflict와 capacity로 나눈다.
+ */
+struct sw_tlb_acct {
+  struct tlb_stat pid[SW_TLB_PSTAT]; //pid % SW_TLB_PSTAT 슬롯
+  struct {
+    uint tag;
+    uint va_page;
+    uint kind;                       //TLB_EVICT_*, 0이면 빈 칸
+  } shadow[SW_TLB_SHADOW];
+  uint shadow_next;                  //다음에 덮어쓸 shadow 칸
+  struct {
+    uint hits;
+    uint misses;
+  } cls[TLB_CLASS_NUM];              //분할 클래스별 히트/미스
+} __attribute__((aligned(64))) sw_tlb_acct[NCPU];
+
+#define SW_PWC_SIZE 8 //CPU별 page-walk cache 엔트리 수
+
+/**
+ * @struct sw_vtop의 PDE 읽기를 건너뛰기 위한 page-walk cache (CPU마다 하나, 락 없음)
+ *
+ * (pgdir, PDX) -> 페이지 테이블 가상 주소를 기억한다. xv6에서 한 번 채워진 PDE는 freevm()까지 바뀌지 않으므로
+ * 페이지 테이블 페이지가 해제될 때(freevm)만 전역 세대를 올려 모든 CPU의 엔트리를 한 번에 무효화한다.
+ * deallocuvm()은 데이터 프레임만 해제하고 페이지 테이블 페이지는 남겨 두므로 무효화할 필요가 없다.
+ */
+struct sw_pwc {
+  struct {
+    pde_t *pgdir; //페이지 디렉터리
+    uint pdx;     //페이지 디렉터리 인덱스
+    pte_t *pgtab; //PDE가 가리키는 페이지 테이블 (커널 가상 주소)
+    uint gen;     //채울 때의 세대, sw_pwc_gen과 다르면 무효
+  } entries[SW_PWC_SIZE];
+  uint hits;      //PDE 읽기를 건너뛴 횟수
+  uint misses;    //PDE를 읽은 횟수
+} __attribute__((aligned(64))) sw_pwc[NCPU];
+
+volatile uint sw_pwc_gen = 1; //page-walk cache 세대 (0은 채워진 적 없는 엔트리)
+
+/**
+ * @struct ipt_entry
+ * @brief IPT의 각 엔트리를 정의한다.
+ */
+struct ipt_entry {
+  uint pfn;               //물리 프레임 번호
+  uint pid;               //소유 프로세스 PID
+  uint va;                //매핑된 가상 주소 (페이지 기준))
+  ushort flags;           //PTE 권한 (P/W/U 등 스냅샷))
+  ushort refcnt;          //역참조 카운트 (옵션))
+  struct ipt_entry *next; //pfn 해시 체인
+  struct ipt_entry *vnext; //(pid, va) 해시 체인
+  struct ipt_entry *pnext; //pfn 순서 인덱스의 프레임별 리스트
+  struct ipt_entry *rnext; //회수 대기 리스트 (체인에서 빠진 뒤에도 next, vnext, pnext는 유지한다)
+};
+
+/**
+ * @brief 하나의 물리 페이지에 매핑된 가상 주소 정보를 담는 구조체
+ */
+struct vlist {
+  uint pid;   //이 가상 주소를 사용하는 프로세스의 PID
+  uint va;    //매핑된 가상 주소 (페이지 경계로 정렬)
+  ushort flags; //PTE의 권한/상태 플래그 스냅샷
+};
+
+/**
+ * @brief 물리 주소 범위 조회 결과 하나 (phys2virt_range)
+ */
+struct pvlist {
+  uint pfn;      //물리 프레임 번호
+  uint pid;      //이 가상 주소를 사용하는 프로세스의 PID
+  uint va;       //매핑된 가상 주소 (페이지 경계로 정렬)
+  ushort flags;  //PTE의 권한/상태 플래그 스냅샷
+  ushort refcnt; //역참조 카운트
+};
+
+/**
+ * @brief phys2virt_range의 조회 위치. 호출할 때마다 다음 위치로 갱신된다.
+ */
+struct prange {
+  uint pa;       //다음에 조회할 물리 주소
+  uint pa_end;   //조회 끝 (포함하지 않음)
+  uint after;    //1이면 pa 프레임에서 (last_pid, last_va) 다음 매핑부터 읽는다. (처음엔 0)
+  uint last_pid; //pa 프레임에서 마지막으로 본 매핑의 PID
+  uint last_va;  //pa 프레임에서 마지막으로 본 매핑의 가상 주소
+};
+
+/**
+ * @brief 범위 조회의 프레임 안 이어 읽기 위치. 프레임별 리스트가 (pid, va) 순서이므로 개수 대신 키로 기억한다.
+ *        (사이에 삽입/삭제가 있어도 계속 남아 있는 매핑을 빠뜨리거나 두 번 읽지 않는다.)
+ */
+struct ipt_key {
+  uint after; //1이면 (pid, va)보다 큰 매핑부터, 0이면 프레임의 처음부터
+  uint pid;
+  uint va;
+};
+
+/**
+ * @brief ipt_export의 커서와 필터. 호출할 때마다 pfn, after, last_pid, last_va, done이 갱신된다.
+ */
+struct ipt_export {
+  uint pfn;      //다음에 읽을 프레임 번호 (처음엔 0)
+  uint after;    //1이면 pfn 프레임에서 (last_pid, last_va) 다음 매핑부터 읽는다. (처음엔 0)
+  uint last_pid; //pfn 프레임에서 마지막으로 본 매핑의 PID (필터와 상관없이)
+  uint last_va;  //pfn 프레임에서 마지막으로 본 매핑의 가상 주소
+  uint pid;    //0이 아니면 이 PID의 엔트리만
+  uint shared; //1이면 refcnt > 1 인 엔트리만
+  uint flags;  //이 플래그 비트가 모두 켜진 엔트리만
+  uint done;   //끝까지 읽었으면 1
+};
+
+#define IPT_ENTRIES_PER_PAGE (PGSIZE / sizeof(struct ipt_entry)) //페이지 하나에 담기는 엔트리 수
+#define IPT_MIN_SHIFT 10   //최소 버킷 수 2^10 = 1024
+#define IPT_MAX_SHIFT 16   //최대 버킷 수 2^16 = 65536
+#define IPT_BUCKETS_PER_PAGE (PGSIZE / sizeof(struct ipt_entry *)) //버킷 페이지 하나의 버킷 수
+#define IPT_DIR_SIZE ((1 << IPT_MAX_SHIFT) / IPT_BUCKETS_PER_PAGE)  //버킷 페이지 최대 개수
+#define IPT_MAX_LOAD 2     //평균 체인 길이가 이 값을 넘으면 버킷 수를 두 배로 늘린다.
+#define IPT_MIN_LOAD_DIV 8 //엔트리 수가 버킷 수의 1/8 아래로 내려가면 절반으로 줄인다.
+#define IPT_REHASH_STEP 4  //변경 연산 한 번마다 옮기는 버킷 수
+#define IPT_READ_RETRIES 8 //락 없는 조회가 락을 잡기 전까지 재시도하는 횟수
+#define IPT_PFN_PER_LEAF (PGSIZE / sizeof(struct ipt_entry *)) //pfn 인덱스 리프 페이지 하나가 담는 프레임 수
+#define IPT_PFN_TOP ((1 << 20) / IPT_PFN_PER_LEAF)             //pfn 인덱스 최상위 칸 수 (4GB까지)
+#define IPT_PFN_END (IPT_PFN_TOP * IPT_PFN_PER_LEAF)           //pfn 인덱스가 다루는 프레임 수
+#define IPT_SCAN_BUDGET 1024 //락 없는 범위 조회가 인터럽트를 끈 채 한 번에 훑는 프레임 수
+#define IPT_EXPORT_CHUNK (PGSIZE / sizeof(struct pvlist)) //ipt_export가 한 번에 복사하는 엔트리 수
+#define IPT_VLIST_CHUNK (PGSIZE / sizeof(struct vlist))   //phys2virt가 한 번에 복사하는 엔트리 수
+
+/**
+ * @struct ipt_table
+ * @brief IPT 버킷 배열. 한 페이지를 넘을 수 있으므로 버킷 페이지 디렉터리로 나누어 둔다.
+ *
+ * 같은 엔트리를 pfn으로 찾는 인덱스(dir)와 (pid, va)로 찾는 인덱스(vdir)를 함께 둔다.
+ * 두 인덱스의 엔트리 수가 같으므로 버킷 수도 같게 두고 크기 변경도 함께 진행한다.
+ */
+struct ipt_table {
+  uint shift;                            //버킷 수 = 1 << shift
+  struct ipt_entry **dir[IPT_DIR_SIZE];  //pfn 인덱스 버킷 페이지
+  struct ipt_entry **vdir[IPT_DIR_SIZE]; //(pid, va) 인덱스 버킷 페이지
+};
+
+/**
+ * @struct IPT 해시 테이블 상태
+ * @brief 크기를 바꿀 때는 멈추지 않고, 변경 연산마다 old의 버킷을 몇 개씩 cur로 옮긴다.
+ *
+ * old에서 rehash_idx보다 작은 버킷은 이미 cur로 옮겨진 상태이다.
+ * 버킷을 옮기는 동안 seq는 홀수이며, 락 없이 읽는 쪽은 seq가 바뀌었으면 다시 읽는다.
+ */
+struct {
+  struct ipt_table tabs[2];  //번갈아 사용하는 테이블
+  struct ipt_table *cur;     //새 엔트리가 들어가는 테이블
+  struct ipt_table *old;     //옮기는 중인 이전 테이블, 없으면 0
+  struct ipt_table *retired; //옮기기가 끝나 회수를 기다리는 테이블
+  uint retired_epoch;        //retired가 된 시점의 epoch
+  uint rehash_idx;           //old에서 옮긴 버킷 수
+  volatile uint seq;         //버킷 이동 중이면 홀수
+  uint count;                //엔트리 수
+} ipt;
+
+/**
+ * @brief pfn 순서로 훑기 위한 2단계 radix 인덱스
+ *
+ * 최상위 칸 하나가 리프 페이지 하나를 가리키고, 리프의 칸마다 그 프레임에 매핑된
+ * 엔트리 리스트(pnext)의 헤드가 들어 있다. 해시와 달리 인접한 프레임이 인접한 칸에
+ * 있으므로 물리 주소 범위를 한 번에 훑을 수 있다. 리프는 한 번 만들면 해제하지 않는다.
+ */
+struct ipt_entry **ipt_pfn_dir[IPT_PFN_TOP];
+
+struct spinlock ipt_lock;
+uint ipt_lock_count = 0; //락 획득 횟수
+uint ipt_operations = 0; //총 연산 횟수
+uint ipt_lock_contended = 0;            //다른 CPU가 잡고 있어 기다린 락 획득 횟수
+unsigned long long ipt_lock_wait = 0;   //락 대기에 쓴 사이클 합계
+uint ipt_dup_bumps = 0;                 //중복 삽입으로 refcnt만 올린 횟수
+
+/**
+ * @brief CPU별 조회 통계. 락 없는 조회도 세므로 CPU마다 다른 캐시 라인에 둔다.
+ */
+struct {
+  uint lookups; //체인 조회 횟수
+  uint probes;  //조회 중 비교한 엔트리 수 합계
+} __attribute__((aligned(64))) ipt_pcpu[NCPU];
+
+#define IPT_HIST_BINS 8 //체인 길이 히스토그램 칸 수: 0, 1, 2, 3, 4, 5-8, 9-16, 17+
+
+/**
+ * @struct ipt_stat
+ * @brief ipt_stat() 시스템 콜로 유저 공간에 넘기는 IPT 통계
+ */
+struct ipt_stat {
+  uint entries;                  //엔트리 수
+  uint buckets;                  //버킷 수
+  uint used_buckets;             //비어 있지 않은 버킷 수
+  uint max_chain;                //가장 긴 체인 길이
+  uint chain_hist[IPT_HIST_BINS];//체인 길이 히스토그램
+  uint lookups;                  //체인 조회 횟수
+  uint probes;                   //조회 중 비교한 엔트리 수 합계
+  uint avg_probes_x100;          //조회당 평균 비교 횟수 x 100
+  uint dup_bumps;                //중복 삽입으로 refcnt만 올린 횟수
+  uint operations;               //변경 연산 횟수
+  uint lock_acquires;            //ipt_lock 획득 횟수
+  uint lock_contended;           //기다려야 했던 락 획득 횟수
+  uint lock_wait_kcycles;        //락 대기 시간 (1024 사이클 단위)
+  uint resizing;                 //크기 변경 진행 중이면 1
+  uint deferred;                 //지연 모드이면 1
+  uint log_drains;               //변경 로그를 일괄 반영한 횟수
+  uint log_applied;              //반영한 변경 로그 기록 수
+};
+struct ipt_entry *ipt_free_entries; //재사용 가능한 엔트리 리스트 (ipt_lock 보호)
+int ipt_tracking = 1;               //0이면 새 매핑을 IPT에 등록하지 않는다.
+
+//ipt_ctl() 명령
+#define IPT_CTL_TRACK 1       //새 매핑 등록 여부 설정
+#define IPT_CTL_RESET_STATS 2 //조회/락 통계 초기화
+#define IPT_CTL_DEFER 3       //매핑 변경을 로그에 모았다가 반영하는 지연 모드 설정
+#define IPT_CTL_VTOP 4        //sw_vtop의 TLB 미스를 IPT로 처리할지 설정
+
+int sw_vtop_ipt = 0;          //1이면 sw_vtop이 TLB 미스를 (pid, va) IPT 인덱스로 먼저 처리한다.
+
+#define IPT_LOG_SIZE 256 //CPU별 변경 로그 칸 수 (2의 거듭제곱)
+
+//변경 로그 기록 종류
+#define IPT_OP_INSERT 1
+#define IPT_OP_REMOVE 2
+#define IPT_OP_FLAGS 3
+#define IPT_OP_REMOVE_PID 4
+
+/**
+ * @struct ipt_log_rec
+ * @brief 지연 모드에서 IPT에 반영할 매핑 변경 하나
+ */
+struct ipt_log_rec {
+  uint seq;   //전역 순번
+  uint op;    //IPT_OP_*
+  uint pfn;
+  uint pid;
+  uint va;    //페이지 정렬된 가상 주소
+  uint flags;
+};
+
+/**
+ * @struct ipt_log
+ * @brief CPU별 매핑 변경 로그 (링 버퍼)
+ *
+ * 소유 CPU만 인터럽트를 막은 채 기록하고(head), ipt_lock을 잡은 쪽만 꺼내 반영한다(tail).
+ * 생산자와 소비자가 하나씩이므로 기록하는 쪽은 락이 필요 없다.
+ * 기록마다 전역 순번을 붙여 두고 반영할 때 모든 CPU 로그를 순번 순서로 합치므로,
+ * 프로세스가 CPU를 옮겨 다녀도 같은 매핑에 대한 변경은 일어난 순서대로 반영된다.
+ */
+struct ipt_log {
+  struct ipt_log_rec rec[IPT_LOG_SIZE];
+  volatile uint head; //다음에 기록할 위치
+  volatile uint tail; //다음에 반영할 위치
+} __attribute__((aligned(64))) ipt_logs[NCPU];
+
+int ipt_deferred = 0;          //1이면 매핑 변경을 로그에 모았다가 한꺼번에 반영한다.
+volatile uint ipt_log_seq = 0; //다음에 발급할 순번
+uint ipt_log_next = 0;         //다음에 반영할 순번 (ipt_lock 보호)
+uint ipt_log_drains = 0;       //로그를 일괄 반영한 횟수
+uint ipt_log_applied = 0;      //반영한 기록 수
+
+/**
+ * @struct ipt_epoch
+ * @brief IPT 체인을 락 없이 읽기 위한 epoch 기반 회수 상태
+ *
+ * 읽는 쪽은 자기 CPU 슬롯에 현재 epoch를 기록한 뒤 체인을 순회한다.
+ * 체인에서 빠진 엔트리는 바로 재사용하지 않고 limbo 리스트에 두었다가,
+ * 모든 CPU가 그 이후의 epoch로 넘어간 것이 확인되면 프리 리스트로 돌려준다.
+ */
+struct {
+  volatile uint global;          //전역 epoch (1부터 시작)
+  volatile uint active[NCPU];    //CPU별 읽기 구간의 epoch, 0이면 읽기 구간 밖
+  struct ipt_entry *limbo[3];    //epoch % 3 별 회수 대기 엔트리 (ipt_lock 보호)
+} ipt_epoch;
+
+
+/**
+ * @brief spin lock 카운터를 유저 영역으로 넘겨주는 함수, test_c 코드에서만 수행되고 디버깅 용으로 출력된다.
+ */
+int sys_print_ipt_status(void) {
+  cprintf("IPT Status : locks = %d ops = %d entries = %d buckets = %d\n",
+          ipt_lock_count, ipt_operations, ipt.count, 1 << ipt.cur->shift);
+  sw_tlb_print_status();
+  return 0;
+}
+
+/**
+ * @brief ipt_lock을 획득하면서 획득 횟수와 대기 사이클을 기록한다.
+ */
+static void ipt_acquire(void) {
+  unsigned long long t0;
+  int busy;
+
+  busy = ipt_lock.locked;
+  t0 = rdtsc();
+  acquire(&ipt_lock);
+  ipt_lock_wait += rdtsc() - t0;
+  ipt_lock_count++;
+  if (busy)
+    ipt_lock_contended++;
+}
+
+/**
+ * @brief 체인 조회 한 번의 비교 횟수를 현재 CPU의 통계에 더한다.
+ *        인터럽트가 꺼진 상태(락 또는 읽기 구간 안)에서 호출해야 한다.
+ *
+ * @param probes : 이번 조회에서 비교한 엔트리 수
+ */
+static void ipt_count_lookup(uint probes) {
+  int c = cpuid();
+
+  ipt_pcpu[c].lookups++;
+  ipt_pcpu[c].probes += probes;
+}
+
+
+/**
+ * @brief TLB의 set 배열을 목표 크기(sw_tlb_size.nsets)로 새로 할당해 갈아 끼운다. 이전 엔트리는 버린다.
+ *        자기 CPU의 TLB에 대해 인터럽트가 꺼진 상태에서 호출해야 한다. (초기화 때는 모든 CPU에 대해 호출한다.)
+ *
+ * @param t : 크기를 맞출 TLB
+ * @return 성공 시 1, 페이지 할당에 실패해 이전 크기를 유지하면 0
+ */
+static int sw_tlb_apply_size(struct sw_tlb *t) {
+  struct sw_tlb_entry *np[SW_TLB_MAX_PAGES], *op[SW_TLB_MAX_PAGES];
+  uint gen = sw_tlb_size.gen;
+  uint nsets = sw_tlb_size.nsets;
+  int i, n = (nsets + SW_TLB_SETS_PER_PAGE - 1) / SW_TLB_SETS_PER_PAGE;
+
+  //1. 새 set 배열을 할당한다. 실패하면 이전 크기를 유지하고 이 세대는 다시 시도하지 않는다.
+  for (i = 0; i < SW_TLB_MAX_PAGES; i++)
+    np[i] = 0;
+  for (i = 0; i < n; i++) {
+    if ((np[i] = (struct sw_tlb_entry *)kalloc_kernel()) == 0)
+      break;
+    memset(np[i], 0, PGSIZE);
+  }
+  if (i < n) {
+    while (--i >= 0)
+      kfree((char *)np[i]);
+    t->size_gen = gen;
+    sw_tlb_size.alloc_fails++;
+    return 0;
+  }
+
+  //2. 다른 CPU의 무효화가 훑는 중이 아닐 때 갈아 끼운다.
+  acquire(&sw_tlb_l2.lock);
+  for (i = 0; i < SW_TLB_MAX_PAGES; i++) {
+    op[i] = t->pages[i];
+    t->pages[i] = np[i];
+  }
+  t->nsets = nsets;
+  memset(t->state, 0, sizeof(t->state));
+  t->set_filled = 0;
+  t->set_emptied = 0;
+  t->size_gen = gen;
+  release(&sw_tlb_l2.lock);
+
+  //3. 이전 set 배열을 돌려준다.
+  for (i = 0; i < SW_TLB_MAX_PAGES; i++) {
+    if (op[i])
+      kfree((char *)op[i]);
+  }
+  return 1;
+}
+
+/**
+ * @brief 현재 CPU의 TLB를 목표 크기로 맞춘다. 페이지를 할당하므로 락을 잡지 않은 문맥(sw_vtop)에서만 부른다.
+ *        조회/삽입 경로는 크기를 바꾸지 않으므로, 락을 잡은 채 copyout하는 경로에서도 이전 크기 그대로 쓸 수 있다.
+ */
+static void sw_tlb_sync_size(void) {
+  struct sw_tlb *t;
+
+  pushcli();
+  t = &sw_tlb[cpuid()];
+  if (t->size_gen != sw_tlb_size.gen)
+    sw_tlb_apply_size(t);
+  popcli();
+}
+
+/**
+ * @brief 모든 CPU의 L1 TLB 목표 크기를 바꾼다. 각 CPU는 다음 조회 때 크기를 맞춘다.
+ *
+ * @param nsets : 새 set 수 (2의 거듭제곱, SW_TLB_MIN_SETS 이상 SW_TLB_MAX_SETS 이하)
+ */
+static void sw_tlb_resize(uint nsets) {
+  if (nsets == sw_tlb_size.nsets)
+    return ;
+  sw_tlb_size.nsets = nsets;
+  sw_tlb_size.gen++;
+  sw_tlb_size.resizes++;
+}
+
+/**
+ * @brief 모든 CPU의 누적 조회 수와 L1(set + victim buffer) 미스 수를 구한다.
+ */
+static void sw_tlb_l1_counts(uint *lookups, uint *l1_misses) {
+  int c;
+
+  *lookups = *l1_misses = 0;
+  for (c = 0; c < ncpu; c++) {
+    *lookups += sw_tlb[c].hits + sw_tlb[c].huge_hits + sw_tlb[c].victim_hits + sw_tlb[c].l2_hits + sw_tlb[c].misses;
+    *l1_misses += sw_tlb[c].l2_hits + sw_tlb[c].misses;
+  }
+}
+
+/**
+ * @brief 미스율 기반 크기 조절기. 구간이 끝났으면 지난 구간의 L1 미스율로 크기를 정한다.
+ *        인터럽트가 꺼진 상태에서 호출해야 하며, 한 번에 한 CPU만 돈다.
+ */
+static void sw_tlb_autosize(void) {
+  uint lookups, l1_misses, dl, dm, rate;
+
+  if (xchg(&sw_tlb_size.busy, 1))
+    return ;
+  if (ticks - sw_tlb_size.last < SW_TLB_AUTO_WINDOW)
+    goto out;
+
+  //1. 지난 구간의 조회 수와 L1 미스 수를 구한다. (통계가 초기화되었으면 구간을 새로 시작한다.)
+  sw_tlb_l1_counts(&lookups, &l1_misses);
+  if (lookups < sw_tlb_size.lookups || l1_misses < sw_tlb_size.l1_misses)
+    dl = dm = 0;
+  else {
+    dl = lookups - sw_tlb_size.lookups;
+    dm = l1_misses - sw_tlb_size.l1_misses;
+  }
+  sw_tlb_size.last = ticks;
+  sw_tlb_size.lookups = lookups;
+  sw_tlb_size.l1_misses = l1_misses;
+  if (dl < SW_TLB_AUTO_MIN_LOOKUPS || dm > dl) {
+    sw_tlb_size.grown_rate = 0;
+    goto out;
+  }
+
+  //2. 미스율 (천분율, 곱셈이 넘치지 않도록 줄여서 계산한다.)
+  while (dm > 0x3fffff) {
+    dm >>= 1;
+    dl >>= 1;
+  }
+  rate = dm * 1000 / dl;
+
+  //3. 직전에 키웠는데 미스율이 충분히 줄지 않았으면 되돌리고 한동안 키우지 않는다.
+  if (sw_tlb_size.grown_rate) {
+    if (rate * 100 > sw_tlb_size.grown_rate * (100 - SW_TLB_AUTO_GAIN)) {
+      sw_tlb_resize(sw_tlb_size.nsets / 2);
+      sw_tlb_size.reverts++;
+      sw_tlb_size.hold = SW_TLB_AUTO_HOLD;
+    }
+    sw_tlb_size.grown_rate = 0;
+    goto out;
+  }
+  if (sw_tlb_size.hold)
+    sw_tlb_size.hold--;
+
+  //4. 미스율이 높으면 키우고, 낮으면 줄인다.
+  if (rate > SW_TLB_AUTO_GROW && !sw_tlb_size.hold && sw_tlb_size.nsets * 2 <= SW_TLB_MAX_SETS) {
+    sw_tlb_size.grown_rate = rate;
+    sw_tlb_resize(sw_tlb_size.nsets * 2);
+  } else if (rate < SW_TLB_AUTO_SHRINK && sw_tlb_size.nsets / 2 >= SW_TLB_MIN_SETS) {
+    sw_tlb_resize(sw_tlb_size.nsets / 2);
+  }
+
+out:
+  xchg(&sw_tlb_size.busy, 0);
+}
+
+/**
+ * @brief TLB 캐시를 초기화 하는 함수
+ */
+void sw_tlb_init(void) {
+  int c, i, w;
+
+  //0. ASID 배정 상태 초기화
+  initlock(&sw_tlb_asid.lock, "sw_tlb_asid");
+  sw_tlb_asid.gen = 1;
+  sw_tlb_asid.next = 1;
+
+  //0-1. 공유 L2 초기화
+  initlock(&sw_tlb_l2.lock, "sw_tlb_l2");
+  for (i = 0; i < SW_TLB_L2_SETS; i++) {
+    for (w = 0; w < SW_TLB_L2_WAYS; w++)
+      sw_tlb_l2.entries[i][w].valid = 0;
+  }
+  sw_tlb_l2.tick = 0;
+
+  //0-2. 기본 크기로 시작한다.
+  sw_tlb_size.nsets = SW_TLB_SETS;
+  sw_tlb_size.gen = 1;
+  sw_tlb_size.autosize = 0;
+  sw_tlb_size.last = ticks;
+
+  //0-3. 분할하지 않은 상태로 시작한다.
+  for (i = 0; i < TLB_CLASS_NUM; i++) {
+    sw_tlb_l1_mask[i] = SW_TLB_WAY_ALL;
+    sw_tlb_l2_mask[i] = SW_TLB_L2_WAY_ALL;
+  }
+
+  //1. 모든 CPU의 캐시 초기화 (아직 다른 CPU에서 도는 프로세스가 없으므로 여기서 모두 할당한다.)
+  for (c = 0; c < ncpu; c++) {
+    if (!sw_tlb_apply_size(&sw_tlb[c]))
+      panic("sw_tlb_init: kalloc");
+    for (i = 0; i < SW_TLB_VICTIM; i++)
+      sw_tlb[c].victim[i].valid = 0;
+    sw_tlb[c].victim_next = 0;
+    for (i = 0; i < SW_TLB_HUGE; i++)
+      sw_tlb[c].huge[i].valid = 0;
+    sw_tlb[c].huge_next = 0;
+    sw_tlb[c].tick = 0;
+    sw_tlb[c].seed = c + 1;
+    sw_tlb[c].hits = 0;
+    sw_tlb[c].huge_hits = 0;
+    sw_tlb[c].victim_hits = 0;
+    sw_tlb[c].l2_hits = 0;
+    sw_tlb[c].misses = 0;
+  }
+}
+
+/**
+ * @brief TLB 캐시에서 set을 고르기 위한 해시 함수
+ * 
+ * @param t       set을 고를 TLB (CPU마다 크기가 다를 수 있다.)
+ * @param tag     주소 공간 태그
+ * @param va_page va_page 값
+ * 
+ * @return tag, va_page를 사용한 set 번호
+ */
+static uint sw_tlb_hash(struct sw_tlb *t, uint tag, uint va_page) {
+  return ((tag^va_page) & (t->nsets - 1));
+}
+
+/**
+ * @brief set의 첫 way를 구한다. set 배열은 여러 페이지에 나뉘어 있다.
+ */
+static inline struct sw_tlb_entry *sw_tlb_set(struct sw_tlb *t, uint set) {
+  return t->pages[set / SW_TLB_SETS_PER_PAGE] + (set % SW_TLB_SETS_PER_PAGE) * SW_TLB_WAYS;
+}
+
+/**
+ * @brief way 마스크에 켜진 way 수
+ */
+static uint sw_tlb_nways(uint mask) {
+  uint n = 0;
+
+  for (; mask; mask >>= 1)
+    n += mask & 1;
+  return n;
+}
+
+/**
+ * @brief way 마스크에서 n번째(0부터) 켜진 way를 구한다. n은 켜진 way 수보다 작아야 한다.
+ */
+static uint sw_tlb_nth_way(uint mask, uint n) {
+  uint w;
+
+  for (w = 0; w < 32; w++) {
+    if (((mask >> w) & 1) && n-- == 0)
+      return w;
+  }
+  return 0;
+}
+
+/**
+ * @brief set에서 마스크 안의 비어 있는 way를 찾는다. Direct-mapped를 뺀 모든 정책이 먼저 빈 way를 쓴다.
+ *
+ * @param mask : 채울 수 있는 way 마스크 (분할 클래스의 마스크)
+ * @return way 번호, 없으면 -1
+ */
+static int sw_tlb_free_way(struct sw_tlb *t, uint set, uint mask) {
+  int w;
+
+  for (w = 0; w < SW_TLB_WAYS; w++) {
+    if (((mask >> w) & 1) && !sw_tlb_set(t, set)[w].valid)
+      return w;
+  }
+  return -1;
+}
+
+/**
+ * @brief way를 방금 사용했다고 tree-PLRU에 기록한다. 경로의 노드가 모두 반대쪽을 가리키게 한다.
+ *        비트 i(1부터, 힙 순서)는 노드 i에서 다음 교체 대상이 오른쪽(1)/왼쪽(0) 서브트리에 있음을 뜻한다.
+ *
+ * @param t : 현재 CPU의 TLB
+ * @param set : set 번호
+ * @param way : 사용한 way
+ * @param fill : 삽입이면 1, 히트면 0
+ */
+static void plru_touch(struct sw_tlb *t, uint set, uint way, int fill) {
+  uint node = 1;
+  uint bit, level;
+
+  for (level = SW_TLB_WAYS >> 1; level > 0; level >>= 1) {
+    bit = (way & level) ? 1 : 0;
+    if (bit)
+      t->state[set] &= ~(1u << node);
+    else
+      t->state[set] |= (1u << node);
+    node = node * 2 + bit;
+  }
+}
+
+/**
+ * @brief tree-PLRU 교체 대상: 루트부터 비트를 따라 내려간다. 비트가 가리키는 서브트리에 마스크 안의 way가 없으면 반대쪽으로 간다.
+ *
+ * @param key : set을 고른 키 (tag ^ va_page), Direct-mapped에서만 쓴다.
+ * @param mask : 고를 수 있는 way 마스크 (0이 아니어야 한다.)
+ */
+static uint plru_victim(struct sw_tlb *t, uint set, uint key, uint mask) {
+  uint node = 1, lo = 0, half = SW_TLB_WAYS >> 1, bit;
+  int w;
+
+  if ((w = sw_tlb_free_way(t, set, mask)) >= 0)
+    return w;
+  while (node < SW_TLB_WAYS) {
+    bit = (t->state[set] >> node) & 1;
+    if (((mask >> (lo + bit * half)) & ((1u << half) - 1)) == 0)
+      bit ^= 1;
+    lo += bit * half;
+    node = node * 2 + bit;
+    half >>= 1;
+  }
+  return node - SW_TLB_WAYS;
+}
+
+/**
+ * @brief LRU: 히트와 삽입 때마다 사용 시각을 기록한다.
+ */
+static void lru_touch(struct sw_tlb *t, uint set, uint way, int fill) {
+  sw_tlb_set(t, set)[way].age = ++t->tick;
+}
+
+/**
+ * @brief FIFO: 삽입할 때만 시각을 기록한다.
+ */
+static void fifo_touch(struct sw_tlb *t, uint set, uint way, int fill) {
+  if (fill)
+    sw_tlb_set(t, set)[way].age = ++t->tick;
+}
+
+/**
+ * @brief LRU/FIFO 교체 대상: 마스크 안에서 기록된 시각이 가장 오래된 way (시각이 한 바퀴 돌아도 되도록 차이로 비교한다.)
+ */
+static uint oldest_victim(struct sw_tlb *t, uint set, uint key, uint mask) {
+  uint w, victim = sw_tlb_nth_way(mask, 0);
+  int free;
+
+  if ((free = sw_tlb_free_way(t, set, mask)) >= 0)
+    return free;
+  for (w = victim + 1; w < SW_TLB_WAYS; w++) {
+    if (((mask >> w) & 1) && t->tick - sw_tlb_set(t, set)[w].age > t->tick - sw_tlb_set(t, set)[victim].age)
+      victim = w;
+  }
+  return victim;
+}
+
+/**
+ * @brief 사용 기록이 필요 없는 정책 (RANDOM, Direct-mapped)
+ */
+static void none_touch(struct sw_tlb *t, uint set, uint way, int fill) {
+}
+
+/**
+ * @brief RANDOM 교체 대상: 마스크 안의 way 중에서 CPU별 선형 합동 난수로 고른다.
+ */
+static uint random_victim(struct sw_tlb *t, uint set, uint key, uint mask) {
+  int w;
+
+  if ((w = sw_tlb_free_way(t, set, mask)) >= 0)
+    return w;
+  t->seed = t->seed * 1103515245 + 12345;
+  return sw_tlb_nth_way(mask, (t->seed >> 16) % sw_tlb_nways(mask));
+}
+
+/**
+ * @brief CLOCK: 히트와 삽입 때 참조 비트를 켠다.
+ */
+static void clock_touch(struct sw_tlb *t, uint set, uint way, int fill) {
+  sw_tlb_set(t, set)[way].age = 1;
+}
+
+/**
+ * @brief CLOCK 교체 대상: 바늘을 돌리며 참조 비트를 끄고, 이미 꺼진 way를 고른다.
+ *        정책을 바꾸는 도중 다른 정책의 상태가 남아 있어도 범위를 벗어나지 않도록 바늘을 way 수로 나눈다.
+ *        마스크 밖의 way는 참조 비트를 건드리지 않고 지나간다.
+ */
+static uint clock_victim(struct sw_tlb *t, uint set, uint key, uint mask) {
+  uint w;
+  int free;
+
+  if ((free = sw_tlb_free_way(t, set, mask)) >= 0)
+    return free;
+  for (;;) {
+    w = t->state[set] % SW_TLB_WAYS;
+    t->state[set] = (w + 1) % SW_TLB_WAYS;
+    if (((mask >> w) & 1) == 0)
+      continue;
+    if (sw_tlb_set(t, set)[w].age == 0)
+      return w;
+    sw_tlb_set(t, set)[w].age = 0;
+  }
+}
+
+/**
+ * @brief Direct-mapped 교체 대상: set을 고르고 남은 키 비트로 way를 하나로 정한다. (빈 way가 있어도 쓰지 않는다.)
+ *        정해진 way가 마스크 밖이면 마스크 안의 way 중 하나로 다시 정한다.
+ */
+static uint direct_victim(struct sw_tlb *t, uint set, uint key, uint mask) {
+  uint w = (key / t->nsets) % SW_TLB_WAYS;
+
+  if ((mask >> w) & 1)
+    return w;
+  return sw_tlb_nth_way(mask, w % sw_tlb_nways(mask));
+}
+
+/**
+ * @brief TLB 교체 정책. touch는 히트/삽입한 way를 기록하고, victim은 마스크 안에서 삽입할 way를 고른다.
+ */
+struct sw_tlb_policy {
+  char *name;
+  void (*touch)(struct sw_tlb *t, uint set, uint way, int fill);
+  uint (*victim)(struct sw_tlb *t, uint set, uint key, uint mask);
+};
+
+static struct sw_tlb_policy sw_tlb_policies[TLB_POLICY_NUM] = {
+[TLB_POLICY_PLRU]   { "plru",   plru_touch,  plru_victim },
+[TLB_POLICY_LRU]    { "lru",    lru_touch,   oldest_victim },
+[TLB_POLICY_FIFO]   { "fifo",   fifo_touch,  oldest_victim },
+[TLB_POLICY_RANDOM] { "random", none_touch,  random_victim },
+[TLB_POLICY_CLOCK]  { "clock",  clock_touch, clock_victim },
+[TLB_POLICY_DIRECT] { "direct", none_touch,  direct_victim },
+};
+
+static struct sw_tlb_policy * volatile sw_tlb_pol = &sw_tlb_policies[TLB_POLICY_PLRU]; //현재 교체 정책
+
+/**
+ * @brief set 안에서 (tag, va_page)를 가진 way를 찾는다.
+ *
+ * @return way 번호, 없으면 -1
+ */
+static int sw_tlb_find(struct sw_tlb *t, uint set, uint tag, uint va_page) {
+  struct sw_tlb_entry *e;
+  int w;
+
+  for (w = 0; w < SW_TLB_WAYS; w++) {
+    e = &sw_tlb_set(t, set)[w];
+    if (e->valid && e->tag == tag && e->va_page == va_page)
+      return w;
+  }
+  return -1;
+}
+
+/**
+ * @brief 현재 CPU의 PID 통계 슬롯을 구한다. 다른 PID가 쓰던 슬롯이면 비우고 차지한다.
+ *        인터럽트가 꺼진 상태에서 호출해야 한다.
+ */
+static struct tlb_stat *sw_tlb_pstat(uint pid) {
+  struct tlb_stat *s = &sw_tlb_acct[cpuid()].pid[pid % SW_TLB_PSTAT];
+
+  if (s->pid != pid) {
+    memset(s, 0, sizeof(*s));
+    s->pid = pid;
+  }
+  return s;
+}
+
+/**
+ * @brief 현재 CPU에서 돌고 있는 프로세스의 PID (커널 문맥이면 0). 인터럽트가 꺼진 상태에서 호출해야 한다.
+ */
+static uint sw_tlb_cur_pid(void) {
+  struct proc *p = mycpu()->proc;
+
+  return p ? p->pid : 0;
+}
+
+/**
+ * @brief 현재 CPU에서 돌고 있는 프로세스의 분할 클래스 (커널 문맥이면 0). 인터럽트가 꺼진 상태에서 호출해야 한다.
+ */
+static uint sw_tlb_cur_class(void) {
+  struct proc *p = mycpu()->proc;
+
+  return p ? p->tlb_class : 0;
+}
+
+/**
+ * @brief 미스를 세고, shadow 링에서 키를 찾아 cold/conflict/capacity로 분류한다. 인터럽트가 꺼진 상태에서 호출해야 한다.
+ */
+static void sw_tlb_count_miss(uint tag, uint va_page) {
+  struct sw_tlb_acct *a = &sw_tlb_acct[cpuid()];
+  struct tlb_stat *s = sw_tlb_pstat(sw_tlb_cur_pid());
+  uint kind = 0;
+  int i;
+
+  for (i = 0; i < SW_TLB_SHADOW; i++) {
+    if (a->shadow[i].kind && a->shadow[i].tag == tag && a->shadow[i].va_page == va_page) {
+      kind = a->shadow[i].kind;
+      a->shadow[i].kind = 0;
+      break;
+    }
+  }
+
+  s->misses++;
+  if (kind == TLB_EVICT_CONFLICT)
+    s->conflict++;
+  else if (kind == TLB_EVICT_CAPACITY)
+    s->capacity++;
+  else
+    s->cold++;
+}
+
+/**
+ * @brief set에서 유효한 엔트리가 밀려날 때 누가 누구를 밀어냈는지 세고, 다시 미스가 날 때 분류할 수 있게 키를 기억한다.
+ *        인터럽트가 꺼진 상태에서 호출해야 한다.
+ *
+ * @param t : 현재 CPU의 TLB
+ * @param old : 밀려나는 엔트리
+ * @param pid : 밀어내는 PID
+ */
+static void sw_tlb_count_evict(struct sw_tlb *t, struct sw_tlb_entry *old, uint pid) {
+  struct sw_tlb_acct *a = &sw_tlb_acct[cpuid()];
+  struct tlb_stat *s;
+  uint kind = TLB_EVICT_CAPACITY;
+  int i;
+
+  //1. 다른 set에 빈 자리가 있었으면 conflict, TLB 전체가 가득 찼으면 capacity
+  //   유효한 엔트리 수는 채운 횟수와 비운 횟수의 차이로 O(1)에 구한다. (다른 CPU의 무효화와 겹치면 한 번 어긋날 수 있다.)
+  if (t->set_filled - t->set_emptied < t->nsets * SW_TLB_WAYS)
+    kind = TLB_EVICT_CONFLICT;
+  i = a->shadow_next;
+  a->shadow_next = (i + 1) % SW_TLB_SHADOW;
+  a->shadow[i].tag = old->tag;
+  a->shadow[i].va_page = old->va_page;
+  a->shadow[i].kind = kind;
+
+  //2. 밀려난 쪽과 밀어낸 쪽을 센다.
+  s = sw_tlb_pstat(old->pid);
+  if (old->pid == pid) {
+    s->self_evicted++;
+  } else {
+    s->evicted++;
+    s->last_evictor = pid;
+    sw_tlb_pstat(pid)->evicts++;
+  }
+}
+
+/**
+ * @brief 무효화로 지워지는 엔트리를 센다. 인터럽트가 꺼진 상태에서 호출해야 한다.
+ */
+static void sw_tlb_count_inval(struct sw_tlb_entry *e) {
+  sw_tlb_pstat(e->pid)->invalidated++;
+}
+
+/**
+ * @brief L2 set 안에서 (tag, va_page)를 가진 way를 찾는다. sw_tlb_l2.lock을 잡은 상태에서 호출해야 한다.
+ *
+ * @return way 번호, 없으면 -1
+ */
+static int sw_tlb_l2_find(uint set, uint tag, uint va_page) {
+  struct sw_tlb_entry *e;
+  int w;
+
+  for (w = 0; w < SW_TLB_L2_WAYS; w++) {
+    e = &sw_tlb_l2.entries[set][w];
+    if (e->valid && e->tag == tag && e->va_page == va_page)
+      return w;
+  }
+  return -1;
+}
+
+/**
+ * @brief L2 set을 바꾸기 시작한다. 순번이 홀수인 동안 락 없는 조회는 기다렸다가 다시 읽는다.
+ *        sw_tlb_l2.lock을 잡은 상태에서 호출해야 한다.
+ */
+static inline void sw_tlb_l2_write_begin(uint set) {
+  sw_tlb_l2.seq[set]++;
+  __sync_synchronize();
+}
+
+/**
+ * @brief L2 set 변경을 마친다. sw_tlb_l2.lock을 잡은 상태에서 호출해야 한다.
+ */
+static inline void sw_tlb_l2_write_end(uint set) {
+  __sync_synchronize();
+  sw_tlb_l2.seq[set]++;
+}
+
+/**
+ * @brief 락 없이 L2에서 (tag, va_page)를 찾는다. 읽는 동안 set이 바뀌었으면 다시 읽는다.
+ *        인터럽트가 꺼진 상태에서 호출해야 한다. (변경하는 쪽도 인터럽트를 끈 채 락을 잡으므로 기다림은 짧다.)
+ *
+ * 사용 시각은 오래되었을 때만 락 없이 고쳐 쓴다. 그 사이 다른 엔트리로 바뀌었으면 그 엔트리의 시각이 틀어질 뿐
+ * 교체 순서에만 영향이 있고, 자주 쓰는 엔트리마다 매번 쓰지 않아 여러 CPU가 캐시 라인을 주고받지 않는다.
+ */
+static int sw_tlb_l2_read(uint tag, uint va_page, struct sw_tlb_entry *out) {
+  struct sw_tlb_entry *e = 0;
+  uint set = (tag ^ va_page) % SW_TLB_L2_SETS;
+  uint seq, tick;
+  int way;
+
+  for (;;) {
+    //1. 변경 중이면 끝날 때까지 기다린다. (기다림은 재시도로 세지 않는다.)
+    while ((seq = sw_tlb_l2.seq[set]) & 1)
+      ;
+    __sync_synchronize();
+
+    //2. set을 읽고 찾은 엔트리를 복사한다.
+    if ((way = sw_tlb_l2_find(set, tag, va_page)) >= 0) {
+      e = &sw_tlb_l2.entries[set][way];
+      *out = *e;
+    }
+    __sync_synchronize();
+
+    //3. 그 사이 순번이 바뀌지 않았으면 읽은 값이 일관된다. 바뀌었으면 읽기 한 번을 버리고 다시 읽는다.
+    if (sw_tlb_l2.seq[set] == seq)
+      break;
+    sw_tlb[cpuid()].l2_retries++;
+  }
+
+  //4. 사용 시각이 set 한 바퀴 이상 지났으면 갱신한다.
+  if (way >= 0) {
+    tick = sw_tlb_l2.tick;
+    if (tick - e->age > SW_TLB_L2_SETS)
+      e->age = tick;
+  }
+  return way >= 0;
+}
+
+/**
+ * @brief L2에서 (tag, va_page)를 찾는다.
+ *
+ * @param out : 찾은 엔트리를 복사할 곳
+ * @param take : 1이면 찾은 엔트리를 L2에서 뺀다. (exclusive)
+ * @return 찾으면 1, 없으면 0
+ */
+static int sw_tlb_l2_lookup(uint tag, uint va_page, struct sw_tlb_entry *out, int take) {
+  struct sw_tlb_entry *e;
+  uint set = (tag ^ va_page) % SW_TLB_L2_SETS;
+  int way;
+
+  //1. 빼내지 않는 조회는 락 없이 읽는다.
+  if (!take && sw_tlb_l2_seq)
+    return sw_tlb_l2_read(tag, va_page, out);
+
+  //2. 빼내는 조회는 락을 잡고 set을 바꾼다.
+  acquire(&sw_tlb_l2.lock);
+  if ((way = sw_tlb_l2_find(set, tag, va_page)) >= 0) {
+    e = &sw_tlb_l2.entries[set][way];
+    *out = *e;
+    if (take) {
+      sw_tlb_l2_write_begin(set);
+      e->valid = 0;
+      sw_tlb_l2_write_end(set);
+    } else {
+      e->age = ++sw_tlb_l2.tick;
+    }
+  }
+  release(&sw_tlb_l2.lock);
+  return way >= 0;
+}
+
+/**
+ * @brief L2에 엔트리를 넣는다. 같은 키가 있으면 덮어쓰고, 없으면 엔트리를 채운 프로세스 클래스(n->cls)의 way 중
+ *        빈 way나 가장 오래 쓰지 않은 way를 쓴다. (exclusive에서 다른 클래스의 엔트리가 밀려 내려와도 그 클래스의 way에 들어간다.)
+ *
+ * @param n : 넣을 엔트리. 락을 잡은 뒤에도 valid이면 넣는다. (그 사이 무효화되었으면 넣지 않는다.)
+ */
+static void sw_tlb_l2_insert(struct sw_tlb_entry *n) {
+  struct sw_tlb_entry *e;
+  uint set = (n->tag ^ n->va_page) % SW_TLB_L2_SETS;
+  uint mask;
+  int w, way;
+
+  acquire(&sw_tlb_l2.lock);
+  if (!n->valid) {
+    release(&sw_tlb_l2.lock);
+    return ;
+  }
+  if ((way = sw_tlb_l2_find(set, n->tag, n->va_page)) < 0) {
+    mask = sw_tlb_l2_mask[n->cls];
+    way = sw_tlb_nth_way(mask, 0);
+    for (w = way; w < SW_TLB_L2_WAYS; w++) {
+      if (((mask >> w) & 1) == 0)
+        continue;
+      e = &sw_tlb_l2.entries[set][w];
+      if (!e->valid) {
+        way = w;
+        break;
+      }
+      if (sw_tlb_l2.tick - e->age > sw_tlb_l2.tick - sw_tlb_l2.entries[set][way].age)
+        way = w;
+    }
+  }
+  e = &sw_tlb_l2.entries[set][way];
+  sw_tlb_l2_write_begin(set);
+  *e = *n;
+  e->valid = 1;
+  e->age = ++sw_tlb_l2.tick;
+  sw_tlb_l2_write_end(set);
+  release(&sw_tlb_l2.lock);
+}
+
+/**
+ * @brief L2의 빈 way에만 엔트리를 넣는다. 같은 키가 이미 있거나 set에 빈 way가 없으면 넣지 않는다. (fork 때 자식 TLB 예열용)
+ *
+ * @param mask : 채울 수 있는 way 마스크 (자식 클래스의 마스크)
+ * @return 넣었으면 1, 아니면 0
+ */
+static int sw_tlb_l2_fill_free(struct sw_tlb_entry *n, uint mask) {
+  uint set = (n->tag ^ n->va_page) % SW_TLB_L2_SETS;
+  int w, filled = 0;
+
+  acquire(&sw_tlb_l2.lock);
+  if (sw_tlb_l2_find(set, n->tag, n->va_page) < 0) {
+    for (w = 0; w < SW_TLB_L2_WAYS; w++) {
+      if (((mask >> w) & 1) && !sw_tlb_l2.entries[set][w].valid) {
+        sw_tlb_l2_write_begin(set);
+        sw_tlb_l2.entries[set][w] = *n;
+        sw_tlb_l2.entries[set][w].age = ++sw_tlb_l2.tick;
+        sw_tlb_l2_write_end(set);
+        filled = 1;
+        break;
+      }
+    }
+  }
+  release(&sw_tlb_l2.lock);
+  return filled;
+}
+
+/**
+ * @brief L2에서 tag의 [first, last] 가상 페이지 엔트리를 지운다. 범위가 set 수보다 작으면 페이지마다 찾고, 크면 전체를 훑는다.
+ *        sw_tlb_l2.lock을 잡은 상태에서 호출해야 한다.
+ */
+static void sw_tlb_l2_invalidate(uint tag, uint first, uint last) {
+  struct sw_tlb_entry *e;
+  uint va, i, w, set;
+  int way;
+
+  if (last - first + 1 < SW_TLB_L2_SETS) {
+    for (va = first; va <= last; va++) {
+      set = (tag ^ va) % SW_TLB_L2_SETS;
+      if ((way = sw_tlb_l2_find(set, tag, va)) >= 0) {
+        sw_tlb_l2_write_begin(set);
+        sw_tlb_l2.entries[set][way].valid = 0;
+        sw_tlb_l2_write_end(set);
+      }
+    }
+  } else {
+    for (i = 0; i < SW_TLB_L2_SETS; i++) {
+      for (w = 0; w < SW_TLB_L2_WAYS; w++) {
+        e = &sw_tlb_l2.entries[i][w];
+        if (e->valid && e->tag == tag && e->va_page >= first && e->va_page <= last) {
+          sw_tlb_l2_write_begin(i);
+          e->valid = 0;
+          sw_tlb_l2_write_end(i);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief L2를 모두 비운다. sw_tlb_l2.lock을 잡은 상태에서 호출해야 한다.
+ */
+static void sw_tlb_l2_flush(void) {
+  int i, w;
+
+  for (i = 0; i < SW_TLB_L2_SETS; i++) {
+    sw_tlb_l2_write_begin(i);
+    for (w = 0; w < SW_TLB_L2_WAYS; w++)
+      sw_tlb_l2.entries[i][w].valid = 0;
+    sw_tlb_l2_write_end(i);
+  }
+}
+
+/**
+ * @brief L1(set과 victim buffer)에서 완전히 밀려나는 엔트리를 처리한다. exclusive 모드이면 L2로 내려보낸다.
+ */
+static void sw_tlb_spill(struct sw_tlb_entry *e) {
+  if (sw_tlb_l2_mode == TLB_L2_EXCLUSIVE && e->valid)
+    sw_tlb_l2_insert(e);
+}
+
+/**
+ * @brief victim buffer에서 (tag, va_page)를 가진 슬롯을 찾는다.
+ *
+ * @return 슬롯 번호, 없으면 -1
+ */
+static int sw_tlb_vb_find(struct sw_tlb *t, uint tag, uint va_page) {
+  struct sw_tlb_entry *e;
+  int i;
+
+  for (i = 0; i < SW_TLB_VICTIM; i++) {
+    e = &t->victim[i];
+    if (e->valid && e->tag == tag && e->va_page == va_page)
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief 큰 페이지 TLB에서 va_page를 덮는 엔트리를 찾는다.
+ *
+ * @return 슬롯 번호, 없으면 -1
+ */
+static int sw_tlb_huge_find(struct sw_tlb *t, uint tag, uint va_page) {
+  struct sw_tlb_entry *e;
+  int i;
+
+  for (i = 0; i < SW_TLB_HUGE; i++) {
+    e = &t->huge[i];
+    if (e->valid && e->tag == tag && e->va_page == (va_page & ~(NPTENTRIES - 1)))
+      return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief 모든 CPU의 큰 페이지 TLB에서 tag의 [first, last] 가상 페이지와 겹치는 엔트리를 지운다.
+ *        sw_tlb_l2.lock을 잡은 상태에서 호출해야 한다.
+ */
+static void sw_tlb_huge_invalidate(uint tag, uint first, uint last) {
+  struct sw_tlb_entry *e;
+  int c, i;
+
+  for (c = 0; c < ncpu; c++) {
+    for (i = 0; i < SW_TLB_HUGE; i++) {
+      e = &sw_tlb[c].huge[i];
+      if (e->valid && e->tag == tag && e->va_page <= last && e->va_page + NPTENTRIES - 1 >= first) {
+        sw_tlb_count_inval(e);
+        e->valid = 0;
+      }
+    }
+  }
+}
+
+/**
+ * @brief 현재 CPU의 큰 페이지 TLB에 4MB 매핑을 넣는다. (락 없음) 같은 키가 있으면 덮어쓰고, 없으면 FIFO 순서로 교체한다.
+ *
+ * @param va_page : 4MB로 정렬된 첫 가상 페이지
+ * @param pa_page : 4MB로 정렬된 첫 물리 페이지
+ */
+static void sw_tlb_huge_insert(uint tag, uint va_page, uint pa_page, uint flags) {
+  struct sw_tlb_entry *e;
+  struct sw_tlb *t;
+  int i;
+
+  pushcli();
+  t = &sw_tlb[cpuid()];
+  if ((i = sw_tlb_huge_find(t, tag, va_page)) < 0) {
+    i = t->huge_next;
+    t->huge_next = (i + 1) % SW_TLB_HUGE;
+  }
+  e = &t->huge[i];
+  e->tag = tag;
+  e->va_page = va_page;
+  e->pa_page = pa_page;
+  e->flags = flags;
+  e->valid = 1;
+  e->age = 0;
+  e->prefetched = 0;
+  e->cls = sw_tlb_cur_class();
+  e->pid = sw_tlb_cur_pid();
+  popcli();
+}
+
+/**
+ * @brief set에서 밀려나는 엔트리를 victim buffer에 넣는다. 빈 슬롯이 없으면 가장 먼저 넣은 슬롯을 덮어쓴다.
+ */
+static void sw_tlb_vb_put(struct sw_tlb *t, struct sw_tlb_entry *e) {
+  int i;
+
+  for (i = 0; i < SW_TLB_VICTIM; i++) {
+    if (!t->victim[i].valid)
+      break;
+  }
+  if (i == SW_TLB_VICTIM) {
+    i = t->victim_next;
+    t->victim_next = (i + 1) % SW_TLB_VICTIM;
+    sw_tlb_spill(&t->victim[i]);
+  }
+  t->victim[i] = *e;
+}
+
+/**
+ * @brief set에 엔트리를 채운다. 같은 키가 있으면 그 way를 덮어쓰고, 없으면 정책이 고른 way를 쓰며
+ *        그 way에 있던 엔트리는 victim buffer로 보낸다. 인터럽트가 꺼진 상태에서 호출해야 한다.
+ *
+ * @param t : 현재 CPU의 TLB
+ * @param pol : 현재 교체 정책
+ * @param set : set 번호
+ * @return 채운 엔트리 (선반입 표시는 지워져 있다.)
+ */
+static struct sw_tlb_entry *sw_tlb_fill(struct sw_tlb *t, struct sw_tlb_policy *pol, uint set,
+                        uint tag, uint va_page, uint pa_page, uint flags) {
+  struct sw_tlb_entry *e;
+  uint pid = sw_tlb_cur_pid();
+  uint cls = sw_tlb_cur_class();
+  int way;
+
+  //1. 같은 키가 없으면 현재 프로세스 클래스의 way 중에서 교체할 way를 고르고, 밀려나는 엔트리를 victim buffer에 넣는다.
+  if ((way = sw_tlb_find(t, set, tag, va_page)) < 0) {
+    way = pol->victim(t, set, tag ^ va_page, sw_tlb_l1_mask[cls]);
+    if (sw_tlb_set(t, set)[way].valid)
+      sw_tlb_count_evict(t, &sw_tlb_set(t, set)[way], pid);
+    else
+      t->set_filled++;
+    if (sw_tlb_victim_on && sw_tlb_set(t, set)[way].valid)
+      sw_tlb_vb_put(t, &sw_tlb_set(t, set)[way]);
+    else
+      sw_tlb_spill(&sw_tlb_set(t, set)[way]);
+  }
+
+  //2. 캐시에 값을 저장한다.
+  e = &sw_tlb_set(t, set)[way];
+  e->tag = tag;
+  e->va_page = va_page;
+  e->pa_page = pa_page;
+  e->flags = flags;
+  e->valid = 1;
+  e->prefetched = 0;
+  e->cls = cls;
+  e->pid = pid;
+  pol->touch(t, set, way, 1);
+  return e;
+}
+
+/**
+ * @brief TLB 캐시 조회 (현재 CPU의 TLB, 락 없음)
+ * 
+ * @param tag     캐시 조회에 사용할 주소 공간 태그
+ * @param va_page 캐시 조회에 사용할 va_page
+ * @param pa_out  캐시 hit시 반환할 pa_out
+ * @param flags_out 캐시 hit시 반환할 flags_out
+ * @param kcopy   1이면 커널이 유저 메모리에 복사하려는 조회(uva2ka)이다. vtop 통계와 섞이지 않게 따로 센다.
+ * 
+ * @return Hit 시 1, Miss 시 0 반환
+ */
+static int sw_tlb_lookup(uint tag, uint va_page, uint *pa_out, uint *flags_out, int kcopy) {
+  struct sw_tlb_policy *pol;
+  struct sw_tlb *t;
+  struct sw_tlb_entry *e, v;
+  uint set;
+  int way, slot, hit = 0; //히트한 단계 (1: set, 2: victim buffer, 3: L2, 4: 큰 페이지)
+
+  //1. 다른 CPU로 옮겨 가지 않도록 인터럽트를 끄고 현재 CPU의 TLB를 고른다.
+  pushcli();
+  t = &sw_tlb[cpuid()];
+  pol = sw_tlb_pol;
+
+  //2. 해시 함수를 통해 set을 찾고 way를 모두 비교한다.
+  set = sw_tlb_hash(t, tag, va_page);
+  way = sw_tlb_find(t, set, tag, va_page);
+
+  //3. 캐시 HIT인 경우 교체 정책에 사용을 기록한다.
+  if (way >= 0) {
+    e = &sw_tlb_set(t, set)[way];
+    *pa_out = (e->pa_page << 12); //페이지 번호 -> 주소
+    *flags_out = e->flags;
+    pol->touch(t, set, way, 0);
+    hit = 1;
+    if (e->prefetched) {
+      e->prefetched = 0;
+      t->pf_used++;
+    }
+  }
+  //3-1. set에 없으면 큰 페이지 TLB를 찾는다. (4MB 매핑은 set에 들어가지 않는다.)
+  else if ((slot = sw_tlb_huge_find(t, tag, va_page)) >= 0) {
+    e = &t->huge[slot];
+    *pa_out = (e->pa_page + va_page % NPTENTRIES) << 12;
+    *flags_out = e->flags;
+    hit = 4;
+  }
+  //4. set에 없으면 victim buffer를 찾는다. 찾으면 set으로 되돌린다. (set에서 밀려나는 엔트리와 자리를 바꾼다.)
+  else if (sw_tlb_victim_on && (slot = sw_tlb_vb_find(t, tag, va_page)) >= 0) {
+    v = t->victim[slot];
+    t->victim[slot].valid = 0;
+    *pa_out = (v.pa_page << 12);
+    *flags_out = v.flags;
+    sw_tlb_fill(t, pol, set, v.tag, v.va_page, v.pa_page, v.flags);
+    hit = 2;
+    if (v.prefetched)
+      t->pf_used++;
+  }
+  //5. L1에 없으면 공유 L2를 찾는다. 찾으면 L1에 채운다. (exclusive이면 L2에서 옮겨 온다.)
+  else if (sw_tlb_l2_mode != TLB_L2_OFF &&
+           sw_tlb_l2_lookup(tag, va_page, &v, sw_tlb_l2_mode == TLB_L2_EXCLUSIVE)) {
+    *pa_out = (v.pa_page << 12);
+    *flags_out = v.flags;
+    sw_tlb_fill(t, pol, set, tag, va_page, v.pa_page, v.flags);
+    hit = 3;
+    if (v.prefetched)
+      t->pf_used++;
+  }
+  //6. Miss일 경우 0을 반환한다.
+
+  //7. 단계별 통계와 PID별, 분할 클래스별 통계 (커널 복사 경로의 조회는 히트/미스만 따로 센다.)
+  if (kcopy) {
+    if (hit)
+      t->kcopy_hits++;
+    else
+      t->kcopy_misses++;
+  } else {
+    if (hit == 1)
+      t->hits++;
+    else if (hit == 2)
+      t->victim_hits++;
+    else if (hit == 3)
+      t->l2_hits++;
+    else if (hit == 4)
+      t->huge_hits++;
+    else
+      t->misses++;
+    if (hit) {
+      sw_tlb_pstat(sw_tlb_cur_pid())->hits++;
+      sw_tlb_acct[cpuid()].cls[sw_tlb_cur_class()].hits++;
+    } else {
+      sw_tlb_count_miss(tag, va_page);
+      sw_tlb_acct[cpuid()].cls[sw_tlb_cur_class()].misses++;
+    }
+  }
+
+  //8. 크기 조절 구간이 끝났으면 크기를 다시 정한다.
+  if (sw_tlb_size.autosize && ticks - sw_tlb_size.last >= SW_TLB_AUTO_WINDOW)
+    sw_tlb_autosize();
+
+  popcli();
+  return hit != 0;
+}
+
+/**
+ * @brief 현재 CPU의 L1에서 빈 way에만 엔트리를 넣는다. 같은 키가 이미 있거나 set에 빈 way가 없으면 넣지 않는다.
+ *        (fork 때 자식 TLB 예열용, 다른 프로세스의 엔트리를 밀어내지 않는다.)
+ *
+ * @param mask : 채울 수 있는 way 마스크 (자식 클래스의 마스크)
+ * @return 넣었으면 1, 아니면 0
+ */
+static int sw_tlb_fill_free(struct sw_tlb_entry *n, uint mask) {
+  struct sw_tlb *t;
+  uint set;
+  int way = -1;
+
+  pushcli();
+  t = &sw_tlb[cpuid()];
+  set = sw_tlb_hash(t, n->tag, n->va_page);
+  if (sw_tlb_find(t, set, n->tag, n->va_page) < 0 && (way = sw_tlb_free_way(t, set, mask)) >= 0) {
+    sw_tlb_set(t, set)[way] = *n;
+    sw_tlb_pol->touch(t, set, way, 1);
+    t->set_filled++;
+  }
+  popcli();
+  return way >= 0;
+}
+
+/**
+ * @brief TLB 캐시에 삽입 (현재 CPU의 TLB, 락 없음)
+ * 
+ * @param tag     캐시에 저장할 주소 공간 태그
+ * @param va_page 캐시에 저장할 va_page
+ * @param pa_page 캐시에 저장할 pa_page
+ * @param flags   캐시에 저장할 flags
+ * @param prefetch 1이면 선반입이다. 이미 L1에 있으면 채우지 않고, 채운 엔트리에 선반입 표시를 남긴다.
+ *
+ * @return 채웠으면 1, 선반입인데 이미 있어서 채우지 않았으면 0
+ */
+static int sw_tlb_insert(uint tag, uint va_page, uint pa_page, uint flags, int prefetch) {
+  struct sw_tlb_entry n, *e;
+  struct sw_tlb *t;
+  uint set;
+
+  //1. 인터럽트를 끄고 현재 CPU의 TLB를 고른다.
+  pushcli();
+  t = &sw_tlb[cpuid()];
+
+  //2. 삽입할 set을 구해 채운다. 선반입은 이미 있는 엔트리를 건드리지 않는다.
+  set = sw_tlb_hash(t, tag, va_page);
+  if (prefetch && sw_tlb_find(t, set, tag, va_page) >= 0) {
+    popcli();
+    return 0;
+  }
+  e = sw_tlb_fill(t, sw_tlb_pol, set, tag, va_page, pa_page, flags);
+  e->prefetched = prefetch;
+
+  //3. inclusive 모드이면 L2에도 채운다. (선반입 표시는 L1 엔트리에만 남겨 한 번만 센다.)
+  if (sw_tlb_l2_mode == TLB_L2_INCLUSIVE) {
+    n.tag = tag;
+    n.va_page = va_page;
+    n.pa_page = pa_page;
+    n.flags = flags;
+    n.valid = 1;
+    n.prefetched = 0;
+    n.cls = e->cls;
+    n.pid = e->pid;
+    sw_tlb_l2_insert(&n);
+  }
+
+  popcli();
+  return 1;
+}
+
+/**
+ * @brief 캐시 무효화 (특정 엔트리, 모든 CPU)
+ * 
+ * @param tag 무효화할 엔트리를 특정할 주소 공간 태그 (0이면 배정된 적이 없으므로 할 일이 없다.)
+ * @param va  무효화할 엔트리를 특정할 va 변수
+ */
+void sw_tlb_invalidate(uint tag, uint va) {
+  uint set;
+  int c, way;
+
+  if (tag == 0)
+    return ;
+
+  //1. 가상 페이지를 구한다.
+  uint va_page = va >> 12;
+
+  //2. 모든 CPU의 TLB에서 tag, va가 모두 동일한 way를 찾아 invalid하게 바꾼다.
+  //   프로세스가 CPU를 옮겨 다녔다면 이전 CPU의 TLB에도 남아 있을 수 있다.
+  //   CPU마다 크기가 다를 수 있으므로 set은 CPU마다 구한다. (크기는 이 락을 잡고 바뀐다.)
+  acquire(&sw_tlb_l2.lock);
+  for (c = 0; c < ncpu; c++) {
+    set = sw_tlb_hash(&sw_tlb[c], tag, va_page);
+    if ((way = sw_tlb_find(&sw_tlb[c], set, tag, va_page)) >= 0) {
+      sw_tlb_count_inval(&sw_tlb_set(&sw_tlb[c], set)[way]);
+      sw_tlb_set(&sw_tlb[c], set)[way].valid = 0;
+      sw_tlb[c].set_emptied++;
+    }
+    if ((way = sw_tlb_vb_find(&sw_tlb[c], tag, va_page)) >= 0) {
+      sw_tlb_count_inval(&sw_tlb[c].victim[way]);
+      sw_tlb[c].victim[way].valid = 0;
+    }
+  }
+
+  //3. 이 페이지를 덮는 큰 페이지 엔트리와 공유 L2에서도 지운다.
+  sw_tlb_huge_invalidate(tag, va_page, va_page);
+  sw_tlb_l2_invalidate(tag, va_page, va_page);
+  release(&sw_tlb_l2.lock);
+}
+
+/**
+ * @brief 가상 주소 범위 [start, end)의 캐시를 모든 CPU에서 무효화한다.
+ *
+ * 페이지마다 찾으면 페이지 수 x way 수 만큼, 전체를 훑으면 TLB 크기만큼 비교하므로
+ * 범위가 set 수보다 작으면 페이지마다 찾고, 그 이상이면 TLB 전체를 한 번 훑는다.
+ *
+ * @param tag 무효화할 엔트리를 특정할 주소 공간 태그
+ * @param start 범위 시작 가상 주소
+ * @param end 범위 끝 가상 주소 (포함하지 않음)
+ */
+void sw_tlb_invalidate_range(uint tag, uint start, uint end) {
+  struct sw_tlb_entry *e;
+  uint first, last, va;
+  int c, i, w;
+
+  if (tag == 0 || start >= end)
+    return ;
+
+  //1. 페이지 단위 범위를 구한다.
+  first = PGROUNDDOWN(start) >> 12;
+  last = (end - 1) >> 12;
+
+  //2. 범위가 작으면 페이지마다 찾는다.
+  if (last - first + 1 < SW_TLB_RANGE_SWEEP) {
+    for (va = first; va <= last; va++)
+      sw_tlb_invalidate(tag, va << 12);
+    return ;
+  }
+
+  //3. 범위가 크면 모든 CPU의 TLB를 한 번씩 훑는다.
+  acquire(&sw_tlb_l2.lock);
+  for (c = 0; c < ncpu; c++) {
+    for (i = 0; i < sw_tlb[c].nsets; i++) {
+      for (w = 0; w < SW_TLB_WAYS; w++) {
+        e = &sw_tlb_set(&sw_tlb[c], i)[w];
+        if (e->valid && e->tag == tag && e->va_page >= first && e->va_page <= last) {
+          sw_tlb_count_inval(e);
+          e->valid = 0;
+          sw_tlb[c].set_emptied++;
+        }
+      }
+    }
+    for (i = 0; i < SW_TLB_VICTIM; i++) {
+      e = &sw_tlb[c].victim[i];
+      if (e->valid && e->tag == tag && e->va_page >= first && e->va_page <= last) {
+        sw_tlb_count_inval(e);
+        e->valid = 0;
+      }
+    }
+  }
+
+  //4. 범위와 겹치는 큰 페이지 엔트리와 공유 L2에서도 지운다.
+  sw_tlb_huge_invalidate(tag, first, last);
+  sw_tlb_l2_invalidate(tag, first, last);
+  release(&sw_tlb_l2.lock);
+}
+
+/**
+ * @brief 모든 CPU의 TLB와 L2를 비운다. 세대 번호가 한 바퀴 돌았을 때와 교체 정책을 바꿀 때 쓰인다.
+ */
+static void sw_tlb_flush_all(void) {
+  int c, i, w;
+
+  acquire(&sw_tlb_l2.lock);
+  for (c = 0; c < ncpu; c++) {
+    for (i = 0; i < sw_tlb[c].nsets; i++) {
+      for (w = 0; w < SW_TLB_WAYS; w++)
+        sw_tlb_set(&sw_tlb[c], i)[w].valid = 0;
+    }
+    sw_tlb[c].set_emptied = sw_tlb[c].set_filled;
+    for (i = 0; i < SW_TLB_VICTIM; i++)
+      sw_tlb[c].victim[i].valid = 0;
+    for (i = 0; i < SW_TLB_HUGE; i++)
+      sw_tlb[c].huge[i].valid = 0;
+  }
+  sw_tlb_l2_flush();
+  release(&sw_tlb_l2.lock);
+}
+
+/**
+ * @brief 프로세스의 현재 TLB 태그를 구한다. 배정되지 않았거나 이전 세대의 태그이면 새로 배정한다.
+ *
+ * @param p : 프로세스 (0이면 커널 문맥이며 태그 0을 쓴다.)
+ * @return 주소 공간 태그
+ */
+static uint sw_tlb_tag(struct proc *p) {
+  uint tag;
+
+  if (p == 0)
+    return 0;
+
+  //1. 현재 세대의 태그를 이미 가지고 있으면 그대로 쓴다. (대부분의 경우)
+  tag = p->tlb_tag;
+  if (tag != 0 && (tag >> SW_TLB_ASID_BITS) == sw_tlb_asid.gen)
+    return tag;
+
+  //2. 새 ASID를 배정한다. 다 썼으면 세대를 올린다.
+  acquire(&sw_tlb_asid.lock);
+  if (sw_tlb_asid.next == SW_TLB_ASID_MAX) {
+    sw_tlb_asid.next = 1;
+    //2-1. 세대 번호가 한 바퀴 돌면 예전 태그와 겹칠 수 있으므로 실제로 비운다.
+    if (++sw_tlb_asid.gen == SW_TLB_GEN_MAX) {
+      sw_tlb_asid.gen = 1;
+      sw_tlb_flush_all();
+    }
+  }
+  tag = (sw_tlb_asid.gen << SW_TLB_ASID_BITS) | sw_tlb_asid.next++;
+  p->tlb_tag = tag;
+  release(&sw_tlb_asid.lock);
+  return tag;
+}
+
+/**
+ * @brief 프로세스의 TLB 엔트리를 모두 비운다. 공유 TLB는 태그만 버리므로 TLB 크기와 CPU 수에 상관없이 O(1)이고,
+ *        전용 TLB는 프로세스 안에 있으므로 그대로 비운다.
+ * @param p 비울 프로세스
+ */
+void sw_tlb_flush_proc(struct proc *p) {
+  int i;
+
+  p->tlb_tag = 0;
+  for (i = 0; i < PTLB_SIZE; i++)
+    p->ptlb[i].valid = 0;
+  p->tlb_pf_next = 0;
+  p->tlb_pf_degree = 0;
+}
+
+/**
+ * @brief 프로세스 전용 TLB에서 가상 페이지를 찾는다. (direct-mapped, 락 없음)
+ *
+ * @return Hit 시 1, Miss 시 0
+ */
+static int sw_ptlb_lookup(struct proc *p, uint va_page, uint *pa_out, uint *flags_out) {
+  struct ptlb_entry *e = &p->ptlb[va_page % PTLB_SIZE];
+  int hit = e->valid && e->va_page == va_page;
+  int used = 0;
+
+  if (hit) {
+    *pa_out = (e->pa_page << 12);
+    *flags_out = e->flags;
+    used = e->prefetched;
+    e->prefetched = 0;
+  }
+
+  //통계는 CPU별로 센다.
+  pushcli();
+  if (hit) {
+    sw_tlb[cpuid()].private_hits++;
+    sw_tlb_pstat(p->pid)->hits++;
+    sw_tlb_acct[cpuid()].cls[p->tlb_class].hits++;
+  } else {
+    sw_tlb[cpuid()].private_misses++;
+    sw_tlb_pstat(p->pid)->misses++;
+    sw_tlb_pstat(p->pid)->cold++;
+    sw_tlb_acct[cpuid()].cls[p->tlb_class].misses++;
+  }
+  sw_tlb[cpuid()].pf_used += used;
+  popcli();
+  return hit;
+}
+
+/**
+ * @brief 프로세스 전용 TLB에 엔트리를 채운다.
+ *
+ * @param prefetch 1이면 선반입이다. 이미 있으면 채우지 않는다.
+ * @return 채웠으면 1, 아니면 0
+ */
+static int sw_ptlb_insert(struct proc *p, uint va_page, uint pa_page, uint flags, int prefetch) {
+  struct ptlb_entry *e = &p->ptlb[va_page % PTLB_SIZE];
+
+  if (prefetch && e->valid && e->va_page == va_page)
+    return 0;
+  e->va_page = va_page;
+  e->pa_page = pa_page;
+  e->flags = flags;
+  e->valid = 1;
+  e->prefetched = prefetch;
+  return 1;
+}
+
+/**
+ * @brief 프로세스 전용 TLB에서 가상 주소 범위 [start, end)를 무효화한다. 자기 프로세스에 대해서만 호출해야 한다.
+ *
+ * @param p 페이지 테이블을 바꾼 프로세스
+ * @param start 범위 시작 가상 주소
+ * @param end 범위 끝 가상 주소 (포함하지 않음)
+ */
+void sw_ptlb_invalidate(struct proc *p, uint start, uint end) {
+  struct ptlb_entry *e;
+  uint first, last, va;
+  int i;
+
+  if (start >= end)
+    return ;
+  first = PGROUNDDOWN(start) >> 12;
+  last = (end - 1) >> 12;
+
+  //1. 범위가 전용 TLB보다 작으면 페이지마다 자리 하나만 본다.
+  if (last - first + 1 < PTLB_SIZE) {
+    for (va = first; va <= last; va++) {
+      e = &p->ptlb[va % PTLB_SIZE];
+      if (e->valid && e->va_page == va)
+        e->valid = 0;
+    }
+    return ;
+  }
+
+  //2. 크면 전부 훑는다.
+  for (i = 0; i < PTLB_SIZE; i++) {
+    e = &p->ptlb[i];
+    if (e->valid && e->va_page >= first && e->va_page <= last)
+      e->valid = 0;
+  }
+}
+
+/**
+ * @brief page-walk cache에서 (pgdir, pdx)의 페이지 테이블을 찾는다. 없으면 PDE를 읽어 채운다.
+ *
+ * @param pgdir : 페이지 디렉터리
+ * @param pdx : 페이지 디렉터리 인덱스
+ * @return 페이지 테이블 (커널 가상 주소), PDE가 없거나 4MB 큰 페이지이면 0 (큰 페이지는 기억하지 않는다.)
+ */
+static pte_t *sw_pwc_walk(pde_t *pgdir, uint pdx) {
+  struct sw_pwc *w;
+  pte_t *pgtab = 0;
+  uint i, gen;
+
+  pushcli();
+  w = &sw_pwc[cpuid()];
+  i = (((uint)pgdir >> 12) ^ pdx) % SW_PWC_SIZE;
+  gen = sw_pwc_gen;
+
+  //1. 세대와 키가 맞으면 PDE를 읽지 않고 바로 쓴다.
+  if (w->entries[i].gen == gen && w->entries[i].pgdir == pgdir && w->entries[i].pdx == pdx) {
+    pgtab = w->entries[i].pgtab;
+    w->hits++;
+  }
+  //2. 없으면 PDE를 읽고, 있으면 채운다.
+  else {
+    w->misses++;
+    if ((pgdir[pdx] & (PTE_P | PTE_PS)) == PTE_P) {
+      pgtab = (pte_t *)P2V(PTE_ADDR(pgdir[pdx]));
+      w->entries[i].pgdir = pgdir;
+      w->entries[i].pdx = pdx;
+      w->entries[i].pgtab = pgtab;
+      w->entries[i].gen = gen;
+    }
+  }
+
+  popcli();
+  return pgtab;
+}
+
+/**
+ * @brief TLB 통계 현황을 출력한다.
+ */
+void sw_tlb_print_status(void) {
+  static char *l2_modes[] = { "off", "inclusive", "exclusive" };
+  uint hits = 0, vhits = 0, l2hits = 0, hhits = 0, misses = 0, retries = 0;
+  int c, i;
+
+  cprintf("=== SW TLB Statistics ===\n");
+  cprintf("Size:     %d entries (%d sets x %d ways) per CPU, autosize %s\n", sw_tlb_size.nsets * SW_TLB_WAYS,
+          sw_tlb_size.nsets, SW_TLB_WAYS, sw_tlb_size.autosize ? "on" : "off");
+  cprintf("Resize:   %d resizes, %d reverted, %d allocation failures\n", sw_tlb_size.resizes,
+          sw_tlb_size.reverts, sw_tlb_size.alloc_fails);
+  cprintf("Policy:   %s\n", sw_tlb_pol->name);
+  cprintf("Victim:   %d entries per CPU%s\n", SW_TLB_VICTIM, sw_tlb_victim_on ? "" : " (off)");
+  cprintf("L2:       %d entries (%d sets x %d ways) shared, %s, %s reads\n", SW_TLB_L2_SIZE, SW_TLB_L2_SETS,
+          SW_TLB_L2_WAYS, l2_modes[sw_tlb_l2_mode], sw_tlb_l2_seq ? "lock-free" : "locked");
+  cprintf("Private:  %d entries per process%s\n", PTLB_SIZE, sw_tlb_private ? "" : " (off)");
+  cprintf("Huge:     %d 4MB entries per CPU, 4MB mappings %s\n", SW_TLB_HUGE, vm_huge_on ? "on" : "off");
+
+  //1. CPU별 통계를 출력하며 합친다. (다른 CPU가 갱신 중일 수 있으므로 근사값이다.)
+  for (c = 0; c < ncpu; c++) {
+    cprintf("  cpu%d:   hits %d victim hits %d L2 hits %d misses %d\n", c,
+            sw_tlb[c].hits, sw_tlb[c].victim_hits, sw_tlb[c].l2_hits, sw_tlb[c].misses);
+    hits += sw_tlb[c].hits;
+    vhits += sw_tlb[c].victim_hits;
+    l2hits += sw_tlb[c].l2_hits;
+    hhits += sw_tlb[c].huge_hits;
+    misses += sw_tlb[c].misses;
+    retries += sw_tlb[c].l2_retries;
+  }
+  cprintf("Hits:     %d (4MB %d)\n", hits + hhits, hhits);
+  cprintf("Victim:   %d hits\n", vhits);
+  cprintf("L2:       %d hits, %d read retries\n", l2hits, retries);
+  cprintf("Misses:   %d\n", misses);
+  
+  //2. 적중률은 모든 단계의 히트를 합쳐 계산하고, 단계별 비율을 함께 출력한다.
+  uint total = hits + hhits + vhits + l2hits + misses;
+  if (total > 0) {
+    cprintf("Total:    %d\n", total);
+    cprintf("Hit Rate: %d%% (L1 %d%%, 4MB %d%%, victim %d%%, L2 %d%%)\n", ((hits + hhits + vhits + l2hits) * 100) / total,
+            (hits * 100) / total, (hhits * 100) / total, (vhits * 100) / total, (l2hits * 100) / total);
+  }
+
+  //3. 전용 TLB 모드의 히트/미스
+  hits = misses = 0;
+  for (c = 0; c < ncpu; c++) {
+    hits += sw_tlb[c].private_hits;
+    misses += sw_tlb[c].private_misses;
+  }
+  if (hits + misses > 0)
+    cprintf("Private:  %d hits, %d misses (%d%%)\n", hits, misses, (hits * 100) / (hits + misses));
+
+  //4. 선반입: 채운 엔트리 중 실제로 히트가 난 비율
+  hits = misses = 0;
+  for (c = 0; c < ncpu; c++) {
+    misses += sw_tlb[c].pf_issued;
+    hits += sw_tlb[c].pf_used;
+  }
+  cprintf("Prefetch: max %d pages, %d issued, %d used", sw_tlb_pf_max, misses, hits);
+  if (misses > 0)
+    cprintf(" (%d%%)", (hits * 100) / misses);
+  cprintf("\n");
+
+  //5. page-walk cache: 히트 수만큼 페이지 순회의 PDE 읽기 단계를 건너뛰었다.
+  hits = misses = 0;
+  for (c = 0; c < ncpu; c++) {
+    hits += sw_pwc[c].hits;
+    misses += sw_pwc[c].misses;
+  }
+  cprintf("Walk cache: %d PDE reads saved, %d PDE reads\n", hits, misses);
+
+  //6. 커널 복사 경로(uva2ka): 히트 수만큼 copyout의 페이지 테이블 순회를 건너뛰었다.
+  hits = misses = 0;
+  for (c = 0; c < ncpu; c++) {
+    hits += sw_tlb[c].kcopy_hits;
+    misses += sw_tlb[c].kcopy_misses;
+  }
+  cprintf("Kernel copy: %d hits, %d misses%s\n", hits, misses, sw_tlb_kcopy ? "" : " (off)");
+
+  //7. fork 예열: 자식 태그로 미리 채운 엔트리 수
+  hits = misses = 0;
+  for (c = 0; c < ncpu; c++) {
+    hits += sw_tlb[c].warm_filled;
+    misses += sw_tlb[c].warm_skipped;
+  }
+  cprintf("Fork warm: %d filled, %d skipped%s\n", hits, misses, sw_tlb_fork_warm_on ? "" : " (off)");
+
+  //8. 분할 클래스별 way 마스크와 히트율
+  for (i = 0; i < TLB_CLASS_NUM; i++) {
+    hits = misses = 0;
+    for (c = 0; c < ncpu; c++) {
+      hits += sw_tlb_acct[c].cls[i].hits;
+      misses += sw_tlb_acct[c].cls[i].misses;
+    }
+    cprintf("Class %d:  L1 ways 0x%x, L2 ways 0x%x, %d hits, %d misses", i,
+            sw_tlb_l1_mask[i], sw_tlb_l2_mask[i], hits, misses);
+    if (hits + misses > 0)
+      cprintf(" (%d%%)", (hits * 100) / (hits + misses));
+    cprintf("\n");
+  }
+
+  //9. 4MB 큰 페이지 매핑: 연속 물리 페이지가 없어 4KB로 대신한 구간과 쪼갠 큰 페이지
+  cprintf("Huge pages: %d mapped, %d fell back to 4KB, %d split, %d freed\n", vm_huge_stat.mapped,
+          vm_huge_stat.fallbacks, vm_huge_stat.splits, vm_huge_stat.freed);
+}
+
+/**
+ * @brief 모든 CPU의 TLB 통계를 초기화한다.
+ */
+static void sw_tlb_reset_stats(void) {
+  int c;
+
+  for (c = 0; c < ncpu; c++) {
+    sw_tlb[c].hits = 0;
+    sw_tlb[c].huge_hits = 0;
+    sw_tlb[c].victim_hits = 0;
+    sw_tlb[c].l2_hits = 0;
+    sw_tlb[c].l2_retries = 0;
+    sw_tlb[c].kcopy_hits = 0;
+    sw_tlb[c].kcopy_misses = 0;
+    sw_tlb[c].warm_filled = 0;
+    sw_tlb[c].warm_skipped = 0;
+    sw_tlb[c].misses = 0;
+    sw_tlb[c].private_hits = 0;
+    sw_tlb[c].private_misses = 0;
+    sw_tlb[c].pf_issued = 0;
+    sw_tlb[c].pf_used = 0;
+    sw_pwc[c].hits = 0;
+    sw_pwc[c].misses = 0;
+    memset(&sw_tlb_acct[c], 0, sizeof(sw_tlb_acct[c]));
+  }
+  memset(&vm_huge_stat, 0, sizeof(vm_huge_stat));
+}
+
+/**
+ * @brief SW TLB를 제어하는 시스템 콜
+ *
+ * @param cmd : TLB_CTL_POLICY - arg 번호의 교체 정책으로 바꾸고 모든 CPU의 TLB와 통계를 비운다.
+ *              같은 작업을 정책별로 같은 조건(빈 TLB)에서 비교하기 위해서이다. arg가 음수이면 바꾸지 않는다.
+ *              TLB_CTL_RESET_STATS - 히트/미스 통계를 초기화한다.
+ *              TLB_CTL_VICTIM - arg가 0이면 victim buffer를 끄고, 1이면 다시 켠다. 끌 때는 남은 엔트리를 버린다.
+ *              TLB_CTL_L2 - L2 동작 방식을 arg(TLB_L2_OFF, TLB_L2_INCLUSIVE, TLB_L2_EXCLUSIVE)로 바꾸고 L2를 비운다.
+ *              TLB_CTL_PRIVATE - arg가 1이면 sw_vtop이 프로세스 전용 TLB를 쓰고, 0이면 공유 TLB 계층으로 돌아간다.
+ *              TLB_CTL_PREFETCH - TLB 미스 때 선반입할 최대 페이지 수를 arg로 바꾼다. (0이면 끔)
+ *              TLB_CTL_SIZE - CPU별 L1 TLB 엔트리 수를 arg로 바꾼다. (way 수 x 2의 거듭제곱, 음수이면 조회만)
+ *                             자동 조절이 켜져 있으면 다음 구간부터 조절기가 다시 크기를 정한다.
+ *              TLB_CTL_AUTOSIZE - arg가 1이면 L1 미스율에 따라 크기를 자동으로 조절하고, 0이면 현재 크기로 고정한다.
+ *              TLB_CTL_L2_SEQ - arg가 1이면 L2 조회를 락 없이 순번으로 검증하고, 0이면 락을 잡는다. (비교 측정용)
+ *              TLB_CTL_KCOPY - arg가 1이면 uva2ka(copyout)가 자기 주소 공간의 변환에 TLB를 쓰고, 0이면 매번 순회한다.
+ *              TLB_CTL_FORK_WARM - arg가 1이면 fork 때 부모의 뜨거운 페이지로 자식 TLB를 미리 채운다.
+ *              TLB_CTL_CLASS - 현재 프로세스의 분할 클래스를 arg로 바꾼다. 이후 fork한 자식이 물려받는다. (음수이면 조회만)
+ *              TLB_CTL_HUGE - arg가 1이면 allocuvm이 4MB로 정렬된 큰 증가분을 큰 페이지로 매핑하고, 0이면 4KB 페이지만 쓴다.
+ * @param arg : 명령 인자
+ * @return TLB_CTL_RESET_STATS는 0, 그 외에는 이전 설정 값. 실패 시 -1
+ */
+int sys_tlb_ctl(void) {
+  int cmd, arg, old, c, i;
+
+  if (argint(0, &cmd) < 0 || argint(1, &arg) < 0)
+    return -1;
+
+  switch (cmd) {
+  case TLB_CTL_POLICY:
+    old = sw_tlb_pol - sw_tlb_policies;
+    if (arg < 0)
+      return old;
+    if (arg >= TLB_POLICY_NUM)
+      return -1;
+    //1. 정책을 바꾸고 이전 정책의 엔트리와 상태를 버린다.
+    //   다른 CPU가 이전 정책으로 삽입하는 중이어도 조회는 모든 way를 비교하므로 정확성에는 문제가 없다.
+    sw_tlb_pol = &sw_tlb_policies[arg];
+    sw_tlb_flush_all();
+    for (c = 0; c < ncpu; c++) {
+      for (i = 0; i < SW_TLB_MAX_SETS; i++)
+        sw_tlb[c].state[i] = 0;
+    }
+    //2. 통계를 초기화한다.
+    sw_tlb_reset_stats();
+    return old;
+  case TLB_CTL_RESET_STATS:
+    sw_tlb_reset_stats();
+    return 0;
+  case TLB_CTL_VICTIM:
+    old = sw_tlb_victim_on;
+    sw_tlb_victim_on = (arg != 0);
+    if (!sw_tlb_victim_on) {
+      for (c = 0; c < ncpu; c++) {
+        for (i = 0; i < SW_TLB_VICTIM; i++)
+          sw_tlb[c].victim[i].valid = 0;
+      }
+    }
+    return old;
+  case TLB_CTL_L2:
+    if (arg < TLB_L2_OFF || arg > TLB_L2_EXCLUSIVE)
+      return -1;
+    old = sw_tlb_l2_mode;
+    acquire(&sw_tlb_l2.lock);
+    sw_tlb_l2_mode = arg;
+    sw_tlb_l2_flush();
+    release(&sw_tlb_l2.lock);
+    return old;
+  case TLB_CTL_PRIVATE:
+    old = sw_tlb_private;
+    sw_tlb_private = (arg != 0);
+    return old;
+  case TLB_CTL_PREFETCH:
+    if (arg < 0 || arg >= NPTENTRIES)
+      return -1;
+    old = sw_tlb_pf_max;
+    sw_tlb_pf_max = arg;
+    return old;
+  case TLB_CTL_SIZE:
+    old = sw_tlb_size.nsets * SW_TLB_WAYS;
+    if (arg < 0)
+      return old;
+    if (arg % SW_TLB_WAYS)
+      return -1;
+    arg /= SW_TLB_WAYS;
+    if (arg < SW_TLB_MIN_SETS || arg > SW_TLB_MAX_SETS || (arg & (arg - 1)))
+      return -1;
+    sw_tlb_resize(arg);
+    return old;
+  case TLB_CTL_AUTOSIZE:
+    old = sw_tlb_size.autosize;
+    sw_tlb_size.grown_rate = 0;
+    sw_tlb_size.hold = 0;
+    sw_tlb_size.last = ticks;
+    sw_tlb_l1_counts(&sw_tlb_size.lookups, &sw_tlb_size.l1_misses);
+    sw_tlb_size.autosize = (arg != 0);
+    return old;
+  case TLB_CTL_L2_SEQ:
+    old = sw_tlb_l2_seq;
+    sw_tlb_l2_seq = (arg != 0);
+    return old;
+  case TLB_CTL_KCOPY:
+    old = sw_tlb_kcopy;
+    sw_tlb_kcopy = (arg != 0);
+    return old;
+  case TLB_CTL_FORK_WARM:
+    old = sw_tlb_fork_warm_on;
+    sw_tlb_fork_warm_on = (arg != 0);
+    return old;
+  case TLB_CTL_CLASS:
+    old = myproc()->tlb_class;
+    if (arg < 0)
+      return old;
+    if (arg >= TLB_CLASS_NUM)
+      return -1;
+    myproc()->tlb_class = arg;
+    return old;
+  case TLB_CTL_HUGE:
+    old = vm_huge_on;
+    vm_huge_on = (arg != 0);
+    return old;
+  }
+  return -1;
+}
+
+/**
+ * @brief 분할 클래스별 way 마스크를 바꾸거나 조회하고, 클래스별 히트/미스를 돌려주는 시스템 콜
+ *
+ * 마스크는 set 안에서 그 클래스의 프로세스가 채울 수 있는 way이다. 지연에 민감한 클래스에 다른 클래스와 겹치지 않는
+ * way를 주면 그 way의 엔트리는 다른 클래스가 밀어낼 수 없으므로 최소 몫이 보장된다. (victim buffer는 나누지 않는다.)
+ *
+ * @param parts : struct tlb_part[TLB_CLASS_NUM] 배열. set이 1이면 l1_mask, l2_mask를 읽어 적용한다.
+ *                끝나면 현재 마스크와 클래스별 히트/미스로 채워진다.
+ * @param set : 1이면 마스크를 바꾸고, 0이면 조회만 한다.
+ * @return 클래스 수, 마스크가 비었거나 way 범위를 벗어나면 -1 (하나라도 틀리면 아무것도 바꾸지 않는다.)
+ */
+int sys_tlb_part(void) {
+  struct tlb_part *parts, buf[TLB_CLASS_NUM];
+  int set, c, i;
+
+  if (argint(1, &set) < 0)
+    return -1;
+  if (argptr(0, (char **)&parts, sizeof(buf)) < 0)
+    return -1;
+
+  //1. 마스크를 모두 검사한 뒤 한꺼번에 바꾼다. (이미 채워진 엔트리는 그대로 두고, 이후 삽입부터 적용된다.)
+  if (set) {
+    memmove(buf, parts, sizeof(buf));
+    for (i = 0; i < TLB_CLASS_NUM; i++) {
+      if (buf[i].l1_mask == 0 || (buf[i].l1_mask & ~SW_TLB_WAY_ALL) ||
+          buf[i].l2_mask == 0 || (buf[i].l2_mask & ~SW_TLB_L2_WAY_ALL))
+        return -1;
+    }
+    for (i = 0; i < TLB_CLASS_NUM; i++) {
+      sw_tlb_l1_mask[i] = buf[i].l1_mask;
+      sw_tlb_l2_mask[i] = buf[i].l2_mask;
+    }
+  }
+
+  //2. 현재 마스크와 CPU별로 센 클래스별 히트/미스를 합쳐 돌려준다.
+  memset(buf, 0, sizeof(buf));
+  for (i = 0; i < TLB_CLASS_NUM; i++) {
+    buf[i].l1_mask = sw_tlb_l1_mask[i];
+    buf[i].l2_mask = sw_tlb_l2_mask[i];
+    for (c = 0; c < ncpu; c++) {
+      buf[i].hits += sw_tlb_acct[c].cls[i].hits;
+      buf[i].misses += sw_tlb_acct[c].cls[i].misses;
+    }
+  }
+  if (copyout(myproc()->pgdir, (uint)parts, (char *)buf, sizeof(buf)) < 0)
+    return -1;
+  return TLB_CLASS_NUM;
+}
+
+/**
+ * @brief CPU별 PID 통계를 PID별로 합쳐 유저 버퍼에 복사하는 시스템 콜
+ *
+ * @param out : 결과를 받을 struct tlb_stat 배열
+ * @param max : 최대 결과 수
+ * @return 복사한 PID 수, 실패 시 -1 (다른 CPU가 갱신 중일 수 있으므로 근사값이다.)
+ */
+int sys_tlb_stat(void) {
+  struct tlb_stat *out, *buf, *s, *d;
+  int max, c, i, j, n = 0;
+  int cap = PGSIZE / sizeof(struct tlb_stat);
+
+  if (argint(1, &max) < 0 || max < 0)
+    return -1;
+  if (argptr(0, (char **)&out, max * sizeof(struct tlb_stat)) < 0)
+    return -1;
+  if ((buf = (struct tlb_stat *)kalloc_kernel()) == 0)
+    return -1;
+
+  //1. 모든 CPU의 슬롯을 PID별로 합친다. (한 번도 쓰이지 않은 슬롯은 건너뛴다.)
+  for (c = 0; c < ncpu; c++) {
+    for (i = 0; i < SW_TLB_PSTAT; i++) {
+      s = &sw_tlb_acct[c].pid[i];
+      if (s->hits + s->misses + s->evicted + s->self_evicted + s->evicts + s->invalidated == 0)
+        continue;
+      for (j = 0; j < n && buf[j].pid != s->pid; j++)
+        ;
+      if (j == n) {
+        if (n == cap)
+          continue;
+        memset(&buf[n], 0, sizeof(buf[n]));
+        buf[n++].pid = s->pid;
+      }
+      d = &buf[j];
+      d->hits += s->hits;
+      d->misses += s->misses;
+      d->cold += s->cold;
+      d->conflict += s->conflict;
+      d->capacity += s->capacity;
+      d->evicted += s->evicted;
+      d->self_evicted += s->self_evicted;
+      d->evicts += s->evicts;
+      d->invalidated += s->invalidated;
+      if (s->last_evictor)
+        d->last_evictor = s->last_evictor;
+    }
+  }
+
+  //2. 유저 버퍼로 복사한다.
+  if (n > max)
+    n = max;
+  if (n > 0 && copyout(myproc()->pgdir, (uint)out, (char *)buf, n * sizeof(struct tlb_stat)) < 0)
+    n = -1;
+  kfree((char *)buf);
+  return n;
+}
+
+/**
+ * @brief pfn을 통해 인덱스로 사용할 해시값을 구한다.
+ *
+ * 황금비 곱셈(Fibonacci) 해시의 상위 shift 비트를 쓴다. pfn % 버킷수 와 달리
+ * 일정한 간격으로 할당된 프레임들도 여러 버킷으로 고르게 흩어진다.
+ * 
+ * @param pfn : 접근하고자 하는 page frame number
+ * @param shift : 버킷 수의 log2
+ * @return 해시 테이블 인덱스
+ */
+static uint ipt_hash_func(uint pfn, uint shift) {
+  return (pfn * 2654435769U) >> (32 - shift);
+}
+
+/**
+ * @brief (pid, va)를 통해 (pid, va) 인덱스에서 사용할 해시값을 구한다.
+ *
+ * 사용자 가상 페이지 번호는 19비트 안에 들어가므로 pid를 그 위로 올려 섞는다.
+ *
+ * @param pid : 프로세스 ID
+ * @param va : 페이지 정렬된 가상 주소
+ * @param shift : 버킷 수의 log2
+ * @return 해시 테이블 인덱스
+ */
+static uint ipt_vhash_func(uint pid, uint va, uint shift) {
+  return (((va >> 12) ^ (pid << 19)) * 2654435769U) >> (32 - shift);
+}
+
+/**
+ * @brief 테이블의 idx번 버킷 헤드의 주소를 구한다.
+ */
+static struct ipt_entry** ipt_slot(struct ipt_table *t, uint idx) {
+  return &t->dir[idx / IPT_BUCKETS_PER_PAGE][idx % IPT_BUCKETS_PER_PAGE];
+}
+
+/**
+ * @brief 테이블의 (pid, va) 인덱스에서 idx번 버킷 헤드의 주소를 구한다.
+ */
+static struct ipt_entry** ipt_vslot(struct ipt_table *t, uint idx) {
+  return &t->vdir[idx / IPT_BUCKETS_PER_PAGE][idx % IPT_BUCKETS_PER_PAGE];
+}
+
+/**
+ * @brief pfn이 현재 속한 버킷을 구한다.
+ *        크기 변경 중이면 아직 옮기지 않은 old의 버킷일 수 있다.
+ *
+ * @param pfn : 찾을 물리 프레임 번호
+ * @return 버킷 헤드의 주소
+ */
+static struct ipt_entry** ipt_bucket(uint pfn) {
+  struct ipt_table *old = ipt.old;
+  uint idx;
+
+  if (old) {
+    idx = ipt_hash_func(pfn, old->shift);
+    if (idx >= ipt.rehash_idx)
+      return ipt_slot(old, idx);
+  }
+  return ipt_slot(ipt.cur, ipt_hash_func(pfn, ipt.cur->shift));
+}
+
+/**
+ * @brief (pid, va)가 현재 속한 (pid, va) 인덱스 버킷을 구한다.
+ *        두 인덱스는 같은 rehash_idx까지 함께 옮겨진다.
+ *
+ * @param pid : 프로세스 ID
+ * @param va : 페이지 정렬된 가상 주소
+ * @return 버킷 헤드의 주소
+ */
+static struct ipt_entry** ipt_vbucket(uint pid, uint va) {
+  struct ipt_table *old = ipt.old;
+  uint idx;
+
+  if (old) {
+    idx = ipt_vhash_func(pid, va, old->shift);
+    if (idx >= ipt.rehash_idx)
+      return ipt_vslot(old, idx);
+  }
+  return ipt_vslot(ipt.cur, ipt_vhash_func(pid, va, ipt.cur->shift));
+}
+
+/**
+ * @brief 테이블의 버킷 페이지를 모두 해제한다.
+ */
+static void ipt_table_free(struct ipt_table *t) {
+  int i;
+
+  for (i = 0; i < IPT_DIR_SIZE; i++) {
+    if (t->dir[i]) {
+      kfree((char *)t->dir[i]);
+      t->dir[i] = 0;
+    }
+    if (t->vdir[i]) {
+      kfree((char *)t->vdir[i]);
+      t->vdir[i] = 0;
+    }
+  }
+}
+
+/**
+ * @brief 테이블에 1 << shift 개의 빈 버킷을 준비한다.
+ *
+ * @return 0 성공, -1 메모리 부족
+ */
+static int ipt_table_alloc(struct ipt_table *t, uint shift) {
+  uint i;
 
-#define SW_TLB_SIZE 64 //TLB 캐시 크기
+  for (i = 0; i < (1 << shift) / IPT_BUCKETS_PER_PAGE; i++) {
+    if ((t->dir[i] = (struct ipt_entry **)kalloc_kernel()) == 0 ||
+        (t->vdir[i] = (struct ipt_entry **)kalloc_kernel()) == 0) {
+      ipt_table_free(t);
+      return -1;
+    }
+    memset(t->dir[i], 0, PGSIZE);
+    memset(t->vdir[i], 0, PGSIZE);
+  }
+  t->shift = shift;
+  return 0;
+}
 
 /**
- * @struct Direct-Mapped TLB 캐시를 구현한 구조체
+ * @brief IPT 락, 해시 테이블 초기화
  */
-struct sw_tlb{
-  struct sw_tlb_entry entries[SW_TLB_SIZE]; //캐시 set
-  uint hits;                                //히트 카운트
-  uint misses;                              //미스 카운트
-  struct spinlock lock;                 //TLB 락
-} sw_tlb;
+void ipt_init(void) {
+  //1. 락 초기화
+  initlock(&ipt_lock, "ipt");
+
+  //2. 해시 테이블 초기화 (최소 크기로 시작)
+  ipt.cur = &ipt.tabs[0];
+  if (ipt_table_alloc(ipt.cur, IPT_MIN_SHIFT) < 0)
+    panic("ipt_init: out of memory");
+
+  //3. epoch 초기화 (0은 "읽기 구간 밖"을 뜻하므로 1부터 시작)
+  ipt_epoch.global = 1;
+}
 
 /**
- * @struct ipt_entry
- * @brief IPT의 각 엔트리를 정의한다.
+ * @brief IPT 엔트리 하나를 할당한다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * 엔트리마다 페이지를 하나씩 kalloc 하지 않고, 한 페이지를 엔트리 크기로 쪼개어
+ * 프리 리스트에 넣어두고 재사용한다.
+ *
+ * @return 할당된 엔트리, 메모리 부족 시 0
  */
-struct ipt_entry {
-  uint pfn;               //물리 프레임 번호
-  uint pid;               //소유 프로세스 PID
-  uint va;                //매핑된 가상 주소 (페이지 기준))
-  ushort flags;           //PTE 권한 (P/W/U 등 스냅샷))
-  ushort refcnt;          //역참조 카운트 (옵션))
-  struct ipt_entry *next; //해시 체인
-};
+static struct ipt_entry* ipt_entry_alloc(void) {
+  struct ipt_entry *e;
+  char *page;
+  int i;
 
-#define IPT_BUCKETS 1024 //해시 버킷 개수
+  //1. 프리 리스트가 비어 있으면 새 페이지를 엔트리 단위로 쪼개어 채운다.
+  if (ipt_free_entries == 0) {
+    if ((page = kalloc_kernel()) == 0)
+      return 0;
+    for (i = 0; i < IPT_ENTRIES_PER_PAGE; i++) {
+      e = (struct ipt_entry *)page + i;
+      e->next = ipt_free_entries;
+      ipt_free_entries = e;
+    }
+  }
 
-struct ipt_entry *ipt_hash[IPT_BUCKETS];
-struct spinlock ipt_lock;
-uint ipt_lock_count = 0; //락 획득 횟수
-uint ipt_operations = 0; //총 연산 횟수
+  //2. 프리 리스트의 헤드를 꺼내 반환한다.
+  e = ipt_free_entries;
+  ipt_free_entries = e->next;
+  return e;
+}
 
+/**
+ * @brief 사용이 끝난 IPT 엔트리를 프리 리스트로 돌려준다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * @param e 반환할 엔트리
+ */
+static void ipt_entry_free(struct ipt_entry *e) {
+  e->next = ipt_free_entries;
+  ipt_free_entries = e;
+}
 
 /**
- * @brief spin lock 카운터를 유저 영역으로 넘겨주는 함수, test_c 코드에서만 수행되고 디버깅 용으로 출력된다.
+ * @brief 락 없는 IPT 읽기 구간을 시작한다.
+ *        구간 안에서는 선점되지 않도록 인터럽트를 끈다.
  */
-int sys_print_ipt_status(void) {
-  cprintf("IPT Status : locks = %d ops = %d\n", ipt_lock_count, ipt_operations);
-  return 0;
+static void ipt_read_begin(void) {
+  pushcli();
+  ipt_epoch.active[cpuid()] = ipt_epoch.global;
+  __sync_synchronize();
 }
 
+/**
+ * @brief 락 없는 IPT 읽기 구간을 끝낸다.
+ */
+static void ipt_read_end(void) {
+  __sync_synchronize();
+  ipt_epoch.active[cpuid()] = 0;
+  popcli();
+}
 
 /**
- * @brief TLB 캐시를 초기화 하는 함수
+ * @brief 체인에서 빠진 엔트리를 회수 대기 리스트에 넣는다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * 아직 이 엔트리를 읽고 있는 CPU가 있을 수 있으므로 next는 건드리지 않는다.
+ *
+ * @param e 체인에서 제거된 엔트리
  */
-void sw_tlb_init(void) {
+static void ipt_retire(struct ipt_entry *e) {
+  uint slot = ipt_epoch.global % 3;
+
+  e->rnext = ipt_epoch.limbo[slot];
+  ipt_epoch.limbo[slot] = e;
+}
+
+/**
+ * @brief 모든 CPU가 현재 epoch에 있거나 읽기 구간 밖이면 epoch를 하나 올리고,
+ *        두 epoch 전에 회수 대기에 들어간 엔트리들을 프리 리스트로 돌려준다.
+ *        ipt_lock을 잡은 상태에서 호출해야 한다.
+ */
+static void ipt_epoch_advance(void) {
+  struct ipt_entry *e, *next;
+  uint g = ipt_epoch.global;
+  uint slot;
   int i;
-  //1. 락 초기화
-  initlock(&sw_tlb.lock, "sw_tlb");
 
-  //2. 캐시 초기화
-  for(i = 0; i < SW_TLB_SIZE; i++) {
-    sw_tlb.entries[i].valid = 0;
+  //1. 이전 epoch에 머물러 있는 읽기 측이 있으면 다음 기회로 미룬다.
+  __sync_synchronize();
+  for (i = 0; i < ncpu; i++) {
+    if (ipt_epoch.active[i] != 0 && ipt_epoch.active[i] != g)
+      return ;
+  }
+
+  //2. epoch g-2에 회수 대기에 들어간 엔트리는 더 이상 누구도 보고 있지 않다.
+  slot = (g + 1) % 3;
+  for (e = ipt_epoch.limbo[slot]; e; e = next) {
+    next = e->rnext;
+    ipt_entry_free(e);
   }
+  ipt_epoch.limbo[slot] = 0;
+
+  //3. epoch 진행
+  ipt_epoch.global = g + 1;
 
-  sw_tlb.hits = 0;
-  sw_tlb.misses = 0;
+  //4. 옮기기가 끝난 이전 테이블도 같은 규칙으로 회수한다.
+  if (ipt.retired && ipt_epoch.global - ipt.retired_epoch >= 2) {
+    ipt_table_free(ipt.retired);
+    ipt.retired = 0;
+  }
 }
 
 /**
- * @brief TLB 캐시에서 인덱싱을 하기 위한 해시 함수
- * 
- * @param pid     PID 값
- * @param va_page va_page 값
- * 
- * @return pid, va_page를 사용한 해시 값
+ * @brief 버킷 수를 1 << shift 개로 바꾸는 점진적 크기 변경을 시작한다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * @param shift : 새 버킷 수의 log2
  */
-static uint sw_tlb_hash(uint pid, uint va_page) {
-  return ((pid^va_page) % SW_TLB_SIZE);
+static void ipt_resize_begin(uint shift) {
+  struct ipt_table *t;
+
+  //1. 진행 중인 크기 변경이 있거나 이전 테이블이 아직 회수되지 않았으면 미룬다.
+  if (ipt.old || ipt.retired)
+    return ;
+
+  //2. 쓰지 않는 테이블 슬롯에 새 버킷을 준비한다. 메모리가 없으면 지금 크기로 계속 쓴다.
+  t = (ipt.cur == &ipt.tabs[0]) ? &ipt.tabs[1] : &ipt.tabs[0];
+  if (ipt_table_alloc(t, shift) < 0)
+    return ;
+
+  //3. 락 없이 읽는 쪽이 중간 상태를 보지 않도록 seq를 홀수로 만든 뒤 교체한다.
+  ipt.seq++;
+  __sync_synchronize();
+  ipt.old = ipt.cur;
+  ipt.cur = t;
+  ipt.rehash_idx = 0;
+  __sync_synchronize();
+  ipt.seq++;
 }
 
 /**
- * @brief TLB 캐시 조회
- * 
- * @param pid     캐시 조회에 사용할 PID
- * @param va_page 캐시 조회에 사용할 va_page
- * @param pa_out  캐시 hit시 반환할 pa_out
- * @param flags_out 캐시 hit시 반환할 flags_out
- * 
- * @return Hit 시 1, Miss 시 0 반환
+ * @brief 크기 변경 중이면 old의 버킷 IPT_REHASH_STEP 개를 cur로 옮긴다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * 엔트리는 복사하지 않고 그대로 옮긴다. 옮기는 도중 old 체인을 읽던 쪽은 cur 체인으로
+ * 넘어갈 수 있지만, seq가 바뀌었으므로 다시 읽게 된다.
  */
-static int sw_tlb_lookup(uint pid, uint va_page, uint *pa_out, uint *flags_out) {
-  uint index;
-  struct sw_tlb_entry *e;
+static void ipt_rehash_step(void) {
+  struct ipt_entry **from, **to, *e;
+  uint nbuckets, n;
 
-  //1. sw_tlb 락을 획득한다.
-  acquire(&sw_tlb.lock);
+  if (ipt.old == 0)
+    return ;
 
-  //2. 해시 함수를 통한 인덱스 값을 찾는다.
-  index = sw_tlb_hash(pid, va_page);
-  e = &sw_tlb.entries[index];
+  nbuckets = 1 << ipt.old->shift;
 
-  //3. 캐시 HIT인 경우 반환한다.
-  if (e->valid && e->pid == pid && e->va_page == va_page) {
-    //Hit일 경우
-    *pa_out = (e->pa_page << 12); //페이지 번호 -> 주소
-    *flags_out = e->flags;
-    sw_tlb.hits++;
-    release(&sw_tlb.lock);
-    return 1;
+  //1. 이동 구간 시작
+  ipt.seq++;
+  __sync_synchronize();
+
+  //2. 버킷 단위로 엔트리를 새 테이블의 체인 헤드로 옮긴다.
+  for (n = 0; n < IPT_REHASH_STEP && ipt.rehash_idx < nbuckets; n++) {
+    from = ipt_slot(ipt.old, ipt.rehash_idx);
+    while ((e = *from) != 0) {
+      *from = e->next;
+      to = ipt_slot(ipt.cur, ipt_hash_func(e->pfn, ipt.cur->shift));
+      e->next = *to;
+      *to = e;
+    }
+    //2-1. 같은 번호의 (pid, va) 인덱스 버킷도 함께 옮긴다.
+    from = ipt_vslot(ipt.old, ipt.rehash_idx);
+    while ((e = *from) != 0) {
+      *from = e->vnext;
+      to = ipt_vslot(ipt.cur, ipt_vhash_func(e->pid, e->va, ipt.cur->shift));
+      e->vnext = *to;
+      *to = e;
+    }
+    ipt.rehash_idx++;
   }
 
-  //4. Miss일 경우 0을 반환한다.
-  sw_tlb.misses++;
-  release(&sw_tlb.lock);
-  return 0;
+  //3. 다 옮겼으면 이전 테이블은 읽는 쪽이 모두 빠져나간 뒤 회수한다.
+  if (ipt.rehash_idx == nbuckets) {
+    ipt.retired = ipt.old;
+    ipt.retired_epoch = ipt_epoch.global;
+    ipt.old = 0;
+  }
+
+  //4. 이동 구간 끝
+  __sync_synchronize();
+  ipt.seq++;
 }
 
 /**
- * @brief TLB 캐시에 삽입
- * 
- * @param pid     캐시에 저장할 Pid
- * @param va_page 캐시에 저장할 va_page
- * @param pa_page 캐시에 저장할 pa_page
- * @param flags   캐시에 저장할 flags
+ * @brief 변경 연산 끝에 호출되어 크기 변경과 회수를 조금씩 진행한다. ipt_lock을 잡은 상태에서 호출해야 한다.
  */
-static void sw_tlb_insert(uint pid, uint va_page, uint pa_page, uint flags) {
-  uint index;
-  struct sw_tlb_entry *e;
+static void ipt_maintain(void) {
+  uint shift;
+
+  //1. 진행 중인 크기 변경을 조금 진행한다.
+  ipt_rehash_step();
+
+  //2. 부하율에 따라 크기 변경을 시작한다.
+  if (ipt.old == 0) {
+    shift = ipt.cur->shift;
+    if (shift < IPT_MAX_SHIFT && ipt.count > (1 << shift) * IPT_MAX_LOAD)
+      ipt_resize_begin(shift + 1);
+    else if (shift > IPT_MIN_SHIFT && ipt.count < (1 << shift) / IPT_MIN_LOAD_DIV)
+      ipt_resize_begin(shift - 1);
+  }
 
-  //1. 락을 획득한다.
-  acquire(&sw_tlb.lock);
+  //3. 회수 가능한 엔트리와 테이블을 정리한다.
+  ipt_epoch_advance();
+}
 
-  //2. 삽입할 인덱스를 확인한다.
-  index = sw_tlb_hash(pid, va_page);
+/**
+ * @brief pfn 순서 인덱스에서 프레임의 리스트 헤드 주소를 구한다.
+ *
+ * @param pfn : 물리 프레임 번호
+ * @param alloc : 1이면 리프가 없을 때 만든다. ipt_lock을 잡은 상태여야 한다.
+ * @return 리스트 헤드의 주소, 리프가 없거나 만들 수 없으면 0
+ */
+static struct ipt_entry** ipt_pfn_head(uint pfn, int alloc) {
+  struct ipt_entry **leaf;
 
-  //3. 캐시에 값을 저장한다.
-  e = &sw_tlb.entries[index];
-  e->pid = pid;
-  e->va_page = va_page;
-  e->pa_page = pa_page;
-  e->flags = flags;
-  e->valid = 1;
+  leaf = ipt_pfn_dir[pfn / IPT_PFN_PER_LEAF];
+  if (leaf == 0) {
+    if (!alloc || (leaf = (struct ipt_entry **)kalloc_kernel()) == 0)
+      return 0;
+    //락 없이 읽는 쪽이 초기화되지 않은 리프를 보지 않도록 비운 뒤 공개한다.
+    memset(leaf, 0, PGSIZE);
+    __sync_synchronize();
+    ipt_pfn_dir[pfn / IPT_PFN_PER_LEAF] = leaf;
+  }
+  return &leaf[pfn % IPT_PFN_PER_LEAF];
+}
 
-  //4. 락을 해제한다.
-  release(&sw_tlb.lock);
+/**
+ * @brief 프레임별 리스트의 정렬 순서에서 엔트리 e가 (pid, va)보다 앞서는지 본다.
+ */
+static int ipt_key_before(struct ipt_entry *e, uint pid, uint va) {
+  return e->pid < pid || (e->pid == pid && e->va < va);
 }
 
 /**
- * @brief 캐시 무효화 (특정 엔트리)
- * 
- * @param pid 무효화할 엔트리를 특정할 pid 변수
- * @param va  무효화할 엔트리를 특정할 va 변수
+ * @brief 프레임별 리스트의 정렬 순서에서 엔트리 e가 (pid, va)보다 뒤에 오는지 본다. (이어 읽기 커서와 비교할 때)
+ */
+static int ipt_key_after(struct ipt_entry *e, uint pid, uint va) {
+  return e->pid > pid || (e->pid == pid && e->va > va);
+}
+
+/**
+ * @brief 락을 잡은 상태에서 IPT에 엔트리를 삽입한다.
+ *
+ * @param pfn : 엔트리에 저장할 pfn 값
+ * @param pid : 엔트리에 저장할 pid 값
+ * @param va : 엔트리에 저장할 va 값 (페이지 정렬된 값)
+ * @param flags : 엔트리에 저장할 flags 스냅샷
+ * @param check_dup : 1이면 중복 엔트리를 검사한다. 새로 생성된 PID처럼 중복이 있을 수 없으면 0
+ *
+ * @return 0 성공, -1 메모리 부족
  */
-void sw_tlb_invalidate(uint pid, uint va) {
-  uint index;
+static int ipt_insert_locked(uint pfn, uint pid, uint va, uint flags, int check_dup) {
+  struct ipt_entry *e;
+  struct ipt_entry **bucket, **vbucket, **phead;
+  uint probes = 0;
 
-  //1. 가상 페이지 를 구한다.
-  uint va_page = va >> 12;
-  struct sw_tlb_entry *e;
+  //1. 해시 버킷 찾기
+  bucket = ipt_bucket(pfn);
+
+  //2. 중복 엔트리를 검사한다.
+  //   pfn, pid, va_page가 모두 같은 경우 중복으로 처리한다.
+  if (check_dup) {
+    for(e = *bucket; e; e = e->next) {
+      probes++;
+      if (e->pfn == pfn && e->pid == pid && e->va == va) {
+        //2-1. 중복 발견 시 ref 카운트를 증가시킨다.
+        e->refcnt++;
+        ipt_dup_bumps++;
+        ipt_count_lookup(probes);
+        return 0;
+      }
+    }
+    ipt_count_lookup(probes);
+  }
+
+  //3. 중복이 없는 경우 pfn 인덱스 칸과 새 엔트리를 할당한다.
+  if ((phead = ipt_pfn_head(pfn, 1)) == 0)
+    return -1;
+  if ((e = ipt_entry_alloc()) == 0)
+    return -1;
+
+  //3-1. 새 엔트리 변수 초기화
+  e->pfn = pfn;
+  e->pid = pid;
+  e->va = va;
+  e->flags = flags;
+  e->refcnt = 1;
+
+  //4. pfn 체인과 (pid, va) 체인은 헤드에, 프레임별 리스트는 (pid, va) 오름차순 자리에 삽입한다.
+  //   중복이 아닌 해시 충돌일 경우 2번으로 처리되는게 아니기에 헤드에 삽입한다.
+  //   프레임별 리스트는 phys2virt가 마지막으로 본 (pid, va) 다음부터 이어 읽을 수 있도록 정렬해 둔다.
+  //   락 없이 읽는 쪽이 초기화되지 않은 엔트리를 보지 않도록 필드를 모두 쓴 뒤 공개한다.
+  e->next = *bucket;
+  vbucket = ipt_vbucket(pid, va);
+  e->vnext = *vbucket;
+  while (*phead && ipt_key_before(*phead, pid, va))
+    phead = &(*phead)->pnext;
+  e->pnext = *phead;
+  __sync_synchronize();
+  *bucket = e;
+  *vbucket = e;
+  *phead = e;
+  ipt.count++;
+  return 0;
+}
 
-  //2. 락을 획득한다.
-  acquire(&sw_tlb.lock);
+/**
+ * @brief 엔트리를 (pid, va) 인덱스와 pfn 순서 인덱스에서 뺀다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * 락 없이 읽는 쪽을 위해 e->vnext, e->pnext는 그대로 둔다.
+ *
+ * @param e : pfn 체인에서 제거한 엔트리
+ */
+static void ipt_unlink_aux(struct ipt_entry *e) {
+  struct ipt_entry **pp;
 
-  //3. 캐시 인덱스를 획득한다.
-  index = sw_tlb_hash(pid, va_page);
-  e = &sw_tlb.entries[index];
+  //1. (pid, va) 체인에서 뺀다.
+  for (pp = ipt_vbucket(e->pid, e->va); *pp; pp = &(*pp)->vnext) {
+    if (*pp == e) {
+      *pp = e->vnext;
+      break;
+    }
+  }
 
-  //4. pid, va가 모두 동일하면 invalid하게 바꾼다.
-  if (e->valid && e->pid == pid && e->va_page == va_page) {
-    e->valid = 0;
+  //2. 프레임별 리스트에서 뺀다.
+  for (pp = ipt_pfn_head(e->pfn, 0); pp && *pp; pp = &(*pp)->pnext) {
+    if (*pp == e) {
+      *pp = e->pnext;
+      break;
+    }
   }
+}
 
-  //5. 락을 해제한다.
-  release(&sw_tlb.lock);
+/**
+ * @brief 락을 잡은 상태에서 IPT 엔트리의 flags 스냅샷을 업데이트 한다.
+ *
+ * @param pfn : 엔트리를 특정할 pfn
+ * @param pid : 엔트리를 특정할 pid
+ * @param va : 엔트리를 특정할 va (페이지 정렬된 값)
+ * @param new_flags : 새로 업데이트할 PTE 권한 스냅샷
+ */
+static void ipt_update_flags_locked(uint pfn, uint pid, uint va, uint new_flags) {
+  struct ipt_entry *e;
+  uint probes = 0;
+
+  //1. 해시 버킷의 체인을 순회하며 대상 엔트리 검색
+  for(e = *ipt_bucket(pfn); e; e = e->next) {
+    probes++;
+    //1-1. 매칭 조건 확인
+    if (e->pfn == pfn && e->pid == pid && e->va == va) {
+      //2. 플래그 업데이트
+      e->flags = new_flags;
+      break;
+    }
+  }
+  ipt_count_lookup(probes);
 }
 
 /**
- * @brief 프로세스 종료 시 캐시 전체 무효화
- * @param pid 무효화할 엔트리를 특정할 pid 변수
+ * @brief 락을 잡은 상태에서 pfn, pid, va에 해당하는 엔트리의 refcnt를 줄이고, 0이 되면 제거한다.
+ *
+ * @param pfn 제거할 페이지의 프레임 번호
+ * @param pid 제거할 페이지의 pid
+ * @param va 제거할 페이지의 va (페이지 정렬된 값)
  */
-void sw_tlb_flush_pid(uint pid) {
-  int i;
+static void ipt_remove_locked(uint pfn, uint pid, uint va) {
+  struct ipt_entry *e, *prev;
+  struct ipt_entry **bucket;
+  uint probes = 0;
+
+  //1. 해시 버킷 찾기
+  bucket = ipt_bucket(pfn);
 
-  //1. 락을 획득한다.
-  acquire(&sw_tlb.lock);
+  //2. 해시 체인 순회
+  prev = 0;
+  for(e = *bucket; e; prev = e, e = e->next) {
+    probes++;
+    //3. refcnt를 감소시킨다.
+    if (e->pfn == pfn && e->pid == pid && e->va == va) {
+      e->refcnt--;
 
-  //2. 해당 pid를 가진 전체 엔트리를 무효화한다.
-  for (i = 0; i < SW_TLB_SIZE; i++) {
-    if (sw_tlb.entries[i].valid && sw_tlb.entries[i].pid == pid) {
-      sw_tlb.entries[i].valid = 0;
+      //4. refcnt가 0인 경우 실제 제거를 결정한다.
+      if (e->refcnt == 0) {
+        //5. 연결 리스트에서 엔트리를 제거한다.
+        if (prev)
+          prev->next = e->next;
+        else
+          *bucket = e->next;
+        ipt_unlink_aux(e);
+        
+        //6. 락 없이 읽는 쪽이 끝날 때까지 회수를 미룬다.
+        ipt_retire(e);
+        ipt.count--;
+      }
+      break;
     }
   }
+  ipt_count_lookup(probes);
+}
+
+/**
+ * @brief 체인 하나에서 주어진 PID의 엔트리를 모두 제거한다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * @param head : 체인의 헤드 주소
+ * @param pid : 제거할 매핑 엔트리의 프로세스 ID
+ */
+static void ipt_remove_pid_chain(struct ipt_entry **head, uint pid) {
+  struct ipt_entry *e, *next, *prev;
 
-  //3. 락을 해제한다.
-  release(&sw_tlb.lock);
+  //1. 체인 탐색을 초기화 한다.
+  prev = 0;
+  e = *head;
+
+  //2. 해시 체인을 순회한다.
+  while(e) {
+    //3. 다음 엔트리를 미리 저장
+    next = e->next;
+
+    //4. PID 일치 여부를 확인한다.
+    if (e->pid == pid) {
+      //5. 연결 리스트에서 엔트리를 제거한다.
+      if (prev)
+        prev->next = next;
+      else
+        *head = next;
+      ipt_unlink_aux(e);
+
+      //6. 제거 엔트리는 락 없이 읽는 쪽이 끝날 때까지 회수를 미룬다.
+      ipt_retire(e);
+      ipt.count--;
+    }
+    //7. 제거하지 않는 경우 엔트리를 보존한다.
+    else {
+      prev = e;
+    }
+    e = next;
+  }
 }
 
 /**
- * @brief TLB 통계 현황을 출력한다.
+ * @brief 락을 잡은 상태에서 주어진 PID의 엔트리를 모두 제거한다.
+ * @param pid : 제거할 매핑 엔트리의 프로세스 ID
  */
-void sw_tlb_print_status(void) {
-  acquire(&sw_tlb.lock);
-  
-  cprintf("=== SW TLB Statistics ===\n");
-  cprintf("Size:     %d entries\n", SW_TLB_SIZE);
-  cprintf("Hits:     %d\n", sw_tlb.hits);
-  cprintf("Misses:   %d\n", sw_tlb.misses);
-  
-  uint total = sw_tlb.hits + sw_tlb.misses;
-  if (total > 0) {
-    cprintf("Total:    %d\n", total);
-    cprintf("Hit Rate: %d%%\n", (sw_tlb.hits * 100) / total);
+static void ipt_remove_by_pid_locked(uint pid) {
+  uint i;
+
+  //1. 크기 변경 중이면 아직 옮기지 않은 old의 버킷부터 정리한다.
+  if (ipt.old) {
+    for (i = ipt.rehash_idx; i < (1 << ipt.old->shift); i++)
+      ipt_remove_pid_chain(ipt_slot(ipt.old, i), pid);
   }
 
-  release(&sw_tlb.lock);
+  //2. 현재 테이블 전체를 정리한다.
+  for (i = 0; i < (1 << ipt.cur->shift); i++)
+    ipt_remove_pid_chain(ipt_slot(ipt.cur, i), pid);
 }
 
 /**
- * @brief pfn을 통해 인덱스로 사용할 해시값을 구한다.
- * 
- * @param pfn : 접근하고자 하는 page frame number
- * @return 해시 테이블 인덱스
+ * @brief 로그 기록 하나를 IPT에 반영한다. ipt_lock을 잡은 상태에서 호출해야 한다.
  */
-uint ipt_hash_func(uint pfn) {
-  return pfn % IPT_BUCKETS;
+static void ipt_log_apply(struct ipt_log_rec *r) {
+  ipt_operations++;
+  switch (r->op) {
+  case IPT_OP_INSERT:
+    if (ipt_insert_locked(r->pfn, r->pid, r->va, r->flags, 1) < 0) {
+      release(&ipt_lock);
+      panic("ipt_log_apply: out of memory");
+    }
+    break;
+  case IPT_OP_REMOVE:
+    ipt_remove_locked(r->pfn, r->pid, r->va);
+    break;
+  case IPT_OP_FLAGS:
+    ipt_update_flags_locked(r->pfn, r->pid, r->va, r->flags);
+    break;
+  case IPT_OP_REMOVE_PID:
+    ipt_remove_by_pid_locked(r->pid);
+    break;
+  }
 }
 
 /**
- * @brief IPT 락, 해시 테이블 초기화
+ * @brief 모든 CPU 로그에 쌓인 변경을 순번 순서대로 IPT에 반영한다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * 시작할 때까지 발급된 순번까지만 반영하므로, 다른 CPU가 계속 기록해도 끝난다.
+ * 순번은 받았지만 아직 기록 중인 칸이 있으면 그 CPU가 기록을 마칠 때까지 기다린다.
+ * (기록은 인터럽트를 막은 채 락 없이 끝나므로 오래 걸리지 않는다.)
  */
-void ipt_init(void) {
-  int i;
+static void ipt_log_drain(void) {
+  struct ipt_log *l;
+  struct ipt_log_rec *r;
+  uint end, i;
+
+  //1. 지금까지 발급된 순번을 끝으로 정한다.
+  end = ipt_log_seq;
+  if (ipt_log_next == end)
+    return ;
+  ipt_log_drains++;
+
+  //2. 각 CPU 로그의 맨 앞 기록 중 다음 순번을 찾아 반영한다.
+  while (ipt_log_next != end) {
+    r = 0;
+    l = 0;
+    for (i = 0; i < NCPU; i++) {
+      l = &ipt_logs[i];
+      if (l->head != l->tail && l->rec[l->tail % IPT_LOG_SIZE].seq == ipt_log_next) {
+        r = &l->rec[l->tail % IPT_LOG_SIZE];
+        break;
+      }
+    }
+    //2-1. 아직 공개되지 않은 순번이면 다시 찾는다.
+    if (r == 0)
+      continue;
+
+    //3. 반영하고 칸을 비운다. 칸을 비운 뒤에는 기록한 CPU가 덮어쓸 수 있다.
+    ipt_log_apply(r);
+    __sync_synchronize();
+    l->tail++;
+    ipt_log_next++;
+    ipt_log_applied++;
+
+    //4. 삽입이 몰려도 테이블이 제때 커지도록 기록마다 조금씩 진행한다.
+    ipt_maintain();
+  }
+}
 
-  //1. 락 초기화
-  initlock(&ipt_lock, "ipt");
+/**
+ * @brief 로그에 남은 변경이 있으면 모두 반영한다. IPT를 읽기 전에 호출한다.
+ */
+static void ipt_log_flush(void) {
+  if (ipt_log_next == ipt_log_seq)
+    return ;
+
+  ipt_acquire();
+  ipt_log_drain();
+  release(&ipt_lock);
+}
+
+/**
+ * @brief 매핑 변경을 현재 CPU의 로그에 추가한다.
+ *
+ * 로그가 가득 찬 경우에만 ipt_lock을 잡고 모든 로그를 반영한다.
+ * 지연 모드를 끄는 쪽은 ipt_deferred를 내린 뒤 로그를 비우고, 기록하는 쪽은 기록을 공개한 뒤
+ * ipt_deferred를 다시 본다. 둘 중 한쪽은 반드시 상대를 보므로, 모드가 꺼지는 순간 기록된 변경도
+ * 다음 반영까지 남아 있지 않는다.
+ *
+ * @return 로그에 기록했으면 1, 그 사이 지연 모드가 꺼졌으면 0 (호출한 쪽이 바로 반영해야 한다.)
+ */
+static int ipt_log_append(uint op, uint pfn, uint pid, uint va, uint flags) {
+  struct ipt_log *l;
+  struct ipt_log_rec *r;
 
-  //2. 해시 테이블 초기화
-  for (i = 0; i < IPT_BUCKETS; i++) {
-    ipt_hash[i] = 0;
+  //1. 기록하는 동안 다른 CPU로 옮겨 가지 않도록 인터럽트를 막는다.
+  //   그 사이 지연 모드가 꺼졌으면 기록하지 않는다.
+  pushcli();
+  if (!ipt_deferred) {
+    popcli();
+    return 0;
+  }
+  l = &ipt_logs[cpuid()];
+
+  //2. 로그가 가득 찼으면 순번을 받기 전에 먼저 비운다.
+  //   순번을 받은 뒤에 락을 기다리면 반영하는 쪽이 그 순번을 기다리며 멈춘다.
+  if (l->head - l->tail == IPT_LOG_SIZE) {
+    ipt_acquire();
+    ipt_log_drain();
+    release(&ipt_lock);
   }
+
+  //3. 순번을 받아 칸을 채운다.
+  r = &l->rec[l->head % IPT_LOG_SIZE];
+  r->seq = __sync_fetch_and_add(&ipt_log_seq, 1);
+  r->op = op;
+  r->pfn = pfn;
+  r->pid = pid;
+  r->va = va;
+  r->flags = flags;
+
+  //4. 칸을 다 쓴 뒤 head를 올려 반영하는 쪽에 공개한다.
+  __sync_synchronize();
+  l->head++;
+
+  //5. 공개한 뒤 지연 모드가 꺼졌으면, 끄는 쪽의 반영이 이 기록을 못 봤을 수 있으므로 직접 반영한다.
+  __sync_synchronize();
+  if (!ipt_deferred)
+    ipt_log_flush();
+  popcli();
+  return 1;
 }
 
 /**
@@ -265,10 +3079,9 @@ void ipt_init(void) {
  * @param flags : 엔트리에 저장할 flags 스냅샷
  */
 void ipt_insert(uint pfn, uint pid, uint va, uint flags) {
-  struct ipt_entry *e;
-  uint bucket;
+  int r;
 
-  if (!ipt_initialized) {
+  if (!ipt_initialized || !ipt_tracking) {
     return ;
   }
 
@@ -276,50 +3089,26 @@ void ipt_insert(uint pfn, uint pid, uint va, uint flags) {
   //   하위 12비트(오프셋)을 제거하여 페이지 시작 주소만 추출한다.
   uint va_aligned = va & ~0xFFF;
 
+  //1-1. 지연 모드에서는 로그에만 남긴다.
+  if (ipt_deferred && ipt_log_append(IPT_OP_INSERT, pfn, pid, va_aligned, flags))
+    return ;
+
   //2. 동시성 제어를 위한 락 획득
   //   IPT 전역 테이블 보호를 위한 스핀락을 획득한다.
-  acquire(&ipt_lock);
-  ipt_lock_count++;
+  //   지연 모드를 끈 직후라면 로그에 남은 변경부터 반영해 순서를 지킨다.
+  ipt_acquire();
+  ipt_log_drain();
   ipt_operations++;
 
-  //3. 해시 버킷 인덱스 계산
-  bucket = ipt_hash_func(pfn);
-
-  //4. 중복 엔트리를 검사한다.
-  //   pfn, pid, va_page가 모두 같은 경우 중복으로 처리한다.
-  for(e = ipt_hash[bucket]; e; e = e->next) {
-    if (e->pfn == pfn && e->pid == pid && e->va == va_aligned) {
-      //4-1. 중복 발견 시 ref 카운트를 증가시킨다.
-      e->refcnt++;
-      release(&ipt_lock);
-      return ;
-    }
-  }
-
-  //5. 중복이 없는 경우 새 엔트리를 할당한다.
-  e = (struct ipt_entry *)kalloc();
-  if (e == 0) {
-    release(&ipt_lock);
-    if (tracing_initialized) {
-      panic("ipt_insert: out of memory");
-    }
-    return ;
-  }
-
-  //5-1. 새 엔트리 변수 초기화
-  e->pfn = pfn;
-  e->pid = pid;
-  e->va = va & ~0xFFF;
-  e->flags = flags;
-  e->refcnt = 1;
+  //3. 엔트리를 삽입하고 크기 변경을 진행한다.
+  r = ipt_insert_locked(pfn, pid, va_aligned, flags, 1);
+  ipt_maintain();
 
-  //7. 해시 체인의 헤드에 삽입한다.
-  //   중복이 아닌 해시 충돌일 경우 4번으로 처리되는게 아니기에 헤드에 삽입한다.
-  e->next = ipt_hash[bucket];
-  ipt_hash[bucket] = e;
-
-  //8. 락 해제한다.
+  //4. 락 해제한다.
   release(&ipt_lock);
+
+  if (r < 0 && tracing_initialized)
+    panic("ipt_insert: out of memory");
 }
 
 /**
@@ -331,33 +3120,25 @@ void ipt_insert(uint pfn, uint pid, uint va, uint flags) {
  * @param new_flags : 새로 업데이트할 PTE 권한 스냅샷
  */
 void ipt_update_flags(uint pfn, uint pid, uint va, uint new_flags) {
-  struct ipt_entry *e;
-  uint bucket;
-
   if (!ipt_initialized) return ;
 
   //1. 가상 주소 페이지 정렬
   uint va_aligned = va & ~0xFFF;
 
-  //2. 락 획득
-  acquire(&ipt_lock);
-
-  //3. 해시 버킷의 인덱스 계산
-  bucket = ipt_hash_func(pfn);
+  //1-1. 지연 모드에서는 로그에만 남긴다.
+  if (ipt_deferred && ipt_log_append(IPT_OP_FLAGS, pfn, pid, va_aligned, new_flags))
+    return ;
 
-  //4. 해시 버킷의 체인을 순회하며 대상 엔트리 검색
-  for(e = ipt_hash[bucket]; e; e = e->next) {
-    //4-1. 매칭 조건 확인
-    if (e->pfn == pfn && e->pid == pid && e->va == va_aligned) {
-      //5. 플래그 업데이트
-      e->flags = new_flags;
-      //6. 락 해제
-      release(&ipt_lock);
-      return ;
-    }
-  }
+  //2. 락 획득 후 남은 로그 반영
+  ipt_acquire();
+  ipt_log_drain();
+  ipt_operations++;
+
+  //3. 플래그 업데이트
+  ipt_update_flags_locked(pfn, pid, va_aligned, new_flags);
 
-  //6. 해당 엔트리가 없을 경우 락 해제 후 반환
+  //4. 크기 변경을 진행하고 락 해제
+  ipt_maintain();
   release(&ipt_lock);
 }
 
@@ -369,45 +3150,25 @@ void ipt_update_flags(uint pfn, uint pid, uint va, uint new_flags) {
  * @param va 제거할 페이지의 va
  */
 void ipt_remove(uint pfn, uint pid, uint va) {
-  struct ipt_entry *e, *prev;
-  uint bucket;
-
   if (!ipt_initialized) return;
 
   //1. 가상 주소 페이지 정렬
   uint va_aligned = va & ~0xFFF;
 
-  //2. 동시성 제어를 위한 락 획득
-  acquire(&ipt_lock);
-
-  //3. 해시 버킷 인덱스 계산
-  bucket = ipt_hash_func(pfn);
+  //1-1. 지연 모드에서는 로그에만 남긴다.
+  if (ipt_deferred && ipt_log_append(IPT_OP_REMOVE, pfn, pid, va_aligned, 0))
+    return ;
 
-  //4. 해시 체인 순회
-  prev = 0;
-  for(e = ipt_hash[bucket]; e; prev = e, e = e->next) {
-    //5. refcnt를 감소시킨다.
-    if (e->pfn == pfn && e->pid == pid && e->va == va_aligned) {
-      e->refcnt--;
+  //2. 동시성 제어를 위한 락 획득 후 남은 로그 반영
+  ipt_acquire();
+  ipt_log_drain();
+  ipt_operations++;
 
-      //6. refcnt가 0인 경우 실제 제거를 결정한다.
-      if (e->refcnt == 0) {
-        //7. 연결 리스트에서 엔트리를 제거한다.
-        if (prev)
-          prev->next = e->next;
-        else
-          ipt_hash[bucket] = e->next;
-        
-        //8. 할당받았던 메모리를 반환한다.
-        kfree((char*)e);
-      }
+  //3. 엔트리 제거
+  ipt_remove_locked(pfn, pid, va_aligned);
 
-      //9. 락 해제후 함수를 종료한다.
-      release(&ipt_lock);
-      return ;
-    }
-  }
-  //10. 일치하는 엔트리가 없는 경우 락을 해재한다.
+  //4. 크기 변경과 회수를 진행하고 락을 해제한다.
+  ipt_maintain();
   release(&ipt_lock);
 }
 
@@ -416,48 +3177,422 @@ void ipt_remove(uint pfn, uint pid, uint va) {
  * @param pid : 제거할 매핑 엔트리의 프로세스 ID
  */
 void ipt_remove_by_pid(uint pid) {
-  struct ipt_entry *e, *next, *prev;
-  int i;
-
   if (!ipt_initialized) return ;
 
-  //1. 락 획득
-  acquire(&ipt_lock);
+  //1. 지연 모드에서는 로그에만 남긴다.
+  if (ipt_deferred && ipt_log_append(IPT_OP_REMOVE_PID, 0, pid, 0, 0))
+    return ;
 
-  //2. 전체 해시 테이블 순회 시작
-  for(i = 0; i < IPT_BUCKETS; i++) {
-    //3. 각 버킷(해시 체인) 탐색을 초기화 한다.
-    prev = 0;
-    e = ipt_hash[i];
+  //2. 락 획득 후 남은 로그 반영
+  ipt_acquire();
+  ipt_log_drain();
+  ipt_operations++;
 
-    //4. 해시 체인을 순회한다.
-    while(e) {
-      //5. 다음 엔트리를 미리 저장
-      next = e->next;
+  //3. 해당 PID의 엔트리를 모두 제거한다.
+  ipt_remove_by_pid_locked(pid);
 
-      //6. PID 일치 여부를 확인한다.
-      if (e->pid == pid) {
-        //7. 연결 리스트에서 엔트리를 제거한다.
-        if (prev)
-          prev->next = next;
-        else
-          ipt_hash[i] = next;
-        
-        //8. 제거 엔트리의 메모리를 해제한다.
-        kfree((char*)e);
+  //4. 크기 변경과 회수를 진행하고 락 해제 후 함수를 종료한다.
+  ipt_maintain();
+  release(&ipt_lock);
+}
 
-        //9. 다음 순회를 준비한다.
-        e = next;
-      }
-      //10. 제거하지 않는 경우 엔트리 보존 및 순회를 진행한다.
-      else {
-        prev = e;
-        e = next;
+/**
+ * @brief 락 없이 pfn에 매핑된 가상 주소 목록을 찾는다.
+ *
+ * 해시 체인 대신 그 프레임의 엔트리만 (pid, va) 순서로 달린 프레임별 리스트를 읽는다.
+ * 이 리스트는 버킷 이동에 영향을 받지 않으므로 seq를 볼 필요가 없다.
+ * 삽입/삭제와 동시에 실행될 수 있으며, 그 순간 리스트에 있던 엔트리를 보게 된다.
+ *
+ * @param pfn : 찾을 물리 프레임 번호
+ * @param cur : 0이 아니면 이 (pid, va) 다음 엔트리부터 담는다. (나누어 조회할 때 사용)
+ * @param out : 결과를 담을 커널 버퍼
+ * @param max : out에 담을 최대 개수
+ * @return out에 담은 개수
+ */
+static int ipt_lookup(uint pfn, struct vlist *cur, struct vlist *out, int max) {
+  struct ipt_entry **phead, *e;
+  uint probes = 0;
+  int n = 0;
+
+  ipt_read_begin();
+
+  //1. 프레임별 리스트에서 커서 다음 위치를 찾는다.
+  phead = ipt_pfn_head(pfn, 0);
+  e = phead ? *phead : 0;
+  while (e && cur && !ipt_key_after(e, cur->pid, cur->va)) {
+    probes++;
+    e = e->pnext;
+  }
+
+  //2. 이어서 최대 max개를 담는다.
+  for (; e && n < max; e = e->pnext) {
+    probes++;
+    out[n].pid = e->pid;
+    out[n].va = e->va;
+    out[n].flags = e->flags;
+    n++;
+  }
+  ipt_count_lookup(probes);
+  ipt_read_end();
+  return n;
+}
+
+/**
+ * @brief 주어진 물리 주소 페이지가 매핑된 모든 가상 주소(va)와 소유 프로세스의 PID 목록을
+ * IPT에서 검색하여 유저 공간으로 복사합니다.
+ *
+ * IPT는 락 없이 읽고, 결과는 커널 페이지 하나에 모아 어떤 락도 잡지 않은 상태에서 copyout 한다.
+ * 페이지가 가득 차면 마지막으로 담은 (pid, va)를 커서로 삼아 다음 묶음을 이어 읽는다.
+ *
+ * @param pa_page : 검색할 물리 페이지 주소 (유저 공간에서 받은 인자)
+ * @param out : 결과를 저장할 유저 공간 버퍼 주소 (struct vlist 배열))
+ * @param max : 유저 공간 버퍼에 복사할 최대 엔트리 수
+ * @return 복사한 개수
+ */
+int sys_phys2virt(void) {
+  uint pa_page;
+  struct vlist *out, *buf;
+  struct vlist cur;
+  int max, want, n;
+  int copied = 0;
+  uint pfn;
+  struct proc *curproc = myproc();
+
+  //1. 인자 받기
+  if (argint(0, (int *)&pa_page) < 0) return -1;
+  if (argptr(1, (char**)&out, sizeof(struct vlist)) < 0) return -1;
+  if (argint(2, &max) < 0) return -1;
+
+  //2. 프레임 번호 계산
+  pfn = PGROUNDDOWN(pa_page) / PGSIZE;
+
+  //2-1. 복사에 쓸 버퍼 페이지를 준비하고, 지연 모드에서 쌓인 변경을 먼저 반영한다.
+  //     구조체 패딩으로 커널 메모리가 새어 나가지 않도록 버퍼를 비워 둔다.
+  if ((buf = (struct vlist *)kalloc_kernel()) == 0)
+    return -1;
+  memset(buf, 0, PGSIZE);
+  ipt_log_flush();
+
+  //3. 묶음 단위로 찾아서 복사한다.
+  while (copied < max) {
+    want = max - copied;
+    if (want > IPT_VLIST_CHUNK)
+      want = IPT_VLIST_CHUNK;
+
+    n = ipt_lookup(pfn, copied ? &cur : 0, buf, want);
+    if (n == 0)
+      break;
+
+    if (copyout(curproc->pgdir,
+                (uint)out + (copied * sizeof(struct vlist)),
+                (char *)buf,
+                n * sizeof(struct vlist)) < 0) {
+      kfree((char *)buf);
+      return -1;
+    }
+    copied += n;
+    cur = buf[n - 1];
+
+    //3-1. 요청보다 적게 찾았으면 리스트를 끝까지 본 것이다.
+    if (n < want)
+      break;
+  }
+  kfree((char *)buf);
+  return copied;
+}
+
+/**
+ * @brief 락 없이 pfn 순서 인덱스를 훑어 [*pfn, end) 범위의 매핑을 pfn 오름차순으로 모은다.
+ *
+ * 인터럽트를 오래 끄지 않도록 IPT_SCAN_BUDGET개 프레임을 본 뒤에는 덜 모았어도 돌아온다.
+ * 호출한 쪽은 *pfn이 end에 닿을 때까지 다시 호출하면 된다.
+ *
+ * @param pfn : 시작 프레임 번호. 다음에 읽을 프레임 번호로 갱신된다.
+ * @param end : 끝 프레임 번호 (포함하지 않음)
+ * @param k : *pfn 프레임에서 이어 읽을 키. 마지막으로 본 매핑으로 갱신된다.
+ * @param f : 필터 (pid, shared, flags만 사용), 0이면 모두 담는다.
+ * @param out : 결과를 담을 커널 버퍼
+ * @param max : out에 담을 최대 개수
+ * @return out에 담은 개수
+ */
+static int ipt_range_lookup(uint *pfn, uint end, struct ipt_key *k, struct ipt_export *f,
+                            struct pvlist *out, int max) {
+  struct ipt_entry **leaf, *e;
+  uint budget;
+  int n = 0;
+
+  ipt_read_begin();
+  for (budget = 0; *pfn < end && n < max && budget < IPT_SCAN_BUDGET; budget++) {
+    //1. 리프가 없으면 리프 하나만큼 건너뛴다.
+    leaf = ipt_pfn_dir[*pfn / IPT_PFN_PER_LEAF];
+    if (leaf == 0) {
+      *pfn = (*pfn / IPT_PFN_PER_LEAF + 1) * IPT_PFN_PER_LEAF;
+      k->after = 0;
+      continue;
+    }
+
+    //2. 프레임의 매핑 중 키보다 큰 것부터 보고, 필터에 맞는 것만 담는다.
+    //   키는 필터와 상관없이 마지막으로 본 매핑이므로 이어서 읽어도 빠뜨리지 않는다.
+    for (e = leaf[*pfn % IPT_PFN_PER_LEAF]; e && n < max; e = e->pnext) {
+      if (k->after && !ipt_key_after(e, k->pid, k->va))
+        continue;
+      k->after = 1;
+      k->pid = e->pid;
+      k->va = e->va;
+      if (f && ((f->pid && e->pid != f->pid) ||
+                (f->shared && e->refcnt <= 1) ||
+                (e->flags & f->flags) != f->flags))
+        continue;
+      out[n].pfn = e->pfn;
+      out[n].pid = e->pid;
+      out[n].va = e->va;
+      out[n].flags = e->flags;
+      out[n].refcnt = e->refcnt;
+      n++;
+    }
+
+    //3. 프레임을 끝까지 봤으면 다음 프레임으로 넘어간다.
+    if (e == 0) {
+      (*pfn)++;
+      k->after = 0;
+    }
+  }
+  ipt_read_end();
+  if (*pfn > end)
+    *pfn = end;
+  return n;
+}
+
+/**
+ * @brief 물리 주소 범위 [r->pa, r->pa_end)에 매핑된 가상 주소들을 pfn 오름차순으로 찾는다.
+ *
+ * 커널 페이지 하나를 버퍼로 써서 IPT_EXPORT_CHUNK개씩 복사한다. out이 가득 차면 멈추고 r에 다음 위치
+ * (프레임과 그 프레임에서 마지막으로 본 (pid, va))를 기록하므로, r->pa < r->pa_end인 동안
+ * 같은 r로 다시 호출하면 이어서 조회한다.
+ *
+ * @param r : 조회 위치 (struct prange, 호출 후 갱신됨)
+ * @param out : 결과를 담을 배열 (struct pvlist)
+ * @param max : out의 최대 개수
+ * @return out에 담은 개수, 실패 시 -1
+ */
+int sys_phys2virt_range(void) {
+  struct prange *ur;
+  struct prange r;
+  struct pvlist *out, *buf;
+  struct ipt_key k;
+  uint pfn, end;
+  int max, want, n;
+  int copied = 0;
+  struct proc *curproc = myproc();
+
+  //1. 인자 받기
+  if (argptr(0, (char **)&ur, sizeof(r)) < 0) return -1;
+  if (argint(2, &max) < 0 || max < 0) return -1;
+  if (argptr(1, (char **)&out, max * sizeof(struct pvlist)) < 0) return -1;
+  r = *ur;
+
+  //2. 프레임 번호 범위와 이어 읽을 키 계산
+  pfn = r.pa / PGSIZE;
+  end = r.pa_end / PGSIZE + (r.pa_end % PGSIZE != 0);
+  k.after = r.after;
+  k.pid = r.last_pid;
+  k.va = r.last_va;
+
+  //2-1. 복사에 쓸 버퍼 페이지를 준비하고, 지연 모드에서 쌓인 변경을 먼저 반영한다.
+  if ((buf = (struct pvlist *)kalloc_kernel()) == 0)
+    return -1;
+  ipt_log_flush();
+
+  //3. 버퍼 단위로 모아서 락 없이 복사한다.
+  while (copied < max && pfn < end) {
+    want = max - copied;
+    if (want > IPT_EXPORT_CHUNK)
+      want = IPT_EXPORT_CHUNK;
+
+    n = ipt_range_lookup(&pfn, end, &k, 0, buf, want);
+    if (n > 0 && copyout(curproc->pgdir,
+                         (uint)out + (copied * sizeof(struct pvlist)),
+                         (char *)buf,
+                         n * sizeof(struct pvlist)) < 0) {
+      kfree((char *)buf);
+      return -1;
+    }
+    copied += n;
+  }
+  kfree((char *)buf);
+
+  //4. 다음 위치를 기록한다.
+  r.pa = pfn * PGSIZE;
+  r.after = k.after;
+  r.last_pid = k.pid;
+  r.last_va = k.va;
+  if (pfn >= end)
+    r.pa = r.pa_end;
+  if (copyout(curproc->pgdir, (uint)ur, (char *)&r, sizeof(r)) < 0)
+    return -1;
+  return copied;
+}
+
+/**
+ * @brief IPT 전체를 pfn 순서로 유저 버퍼에 내보낸다.
+ *
+ * 커널 페이지 하나를 버퍼로 써서 IPT_EXPORT_CHUNK개씩 복사한다. out이 가득 차면
+ * c에 다음 위치(프레임과 그 프레임에서 마지막으로 본 (pid, va))를 기록하므로
+ * c->done이 0인 동안 같은 c로 다시 호출하면 이어서 읽는다.
+ *
+ * @param c : 커서와 필터 (struct ipt_export, 호출 후 갱신됨)
+ * @param out : 결과를 담을 배열 (struct pvlist)
+ * @param max : out의 최대 개수
+ * @return out에 담은 개수, 실패 시 -1
+ */
+int sys_ipt_export(void) {
+  struct ipt_export *uc;
+  struct ipt_export c;
+  struct pvlist *out, *buf;
+  struct ipt_key k;
+  int max, want, n;
+  int copied = 0;
+  struct proc *curproc = myproc();
+
+  //1. 인자 받기
+  if (argptr(0, (char **)&uc, sizeof(c)) < 0) return -1;
+  if (argint(2, &max) < 0 || max < 0) return -1;
+  if (argptr(1, (char **)&out, max * sizeof(struct pvlist)) < 0) return -1;
+  c = *uc;
+  k.after = c.after;
+  k.pid = c.last_pid;
+  k.va = c.last_va;
+
+  //2. 복사에 쓸 버퍼 페이지를 준비하고, 지연 모드에서 쌓인 변경을 반영한다.
+  if ((buf = (struct pvlist *)kalloc_kernel()) == 0)
+    return -1;
+  ipt_log_flush();
+
+  //3. 버퍼 단위로 모아서 락 없이 복사한다.
+  while (copied < max && c.pfn < IPT_PFN_END) {
+    want = max - copied;
+    if (want > IPT_EXPORT_CHUNK)
+      want = IPT_EXPORT_CHUNK;
+
+    n = ipt_range_lookup(&c.pfn, IPT_PFN_END, &k, &c, buf, want);
+    if (n > 0 && copyout(curproc->pgdir,
+                         (uint)out + (copied * sizeof(struct pvlist)),
+                         (char *)buf,
+                         n * sizeof(struct pvlist)) < 0) {
+      kfree((char *)buf);
+      return -1;
+    }
+    copied += n;
+  }
+  kfree((char *)buf);
+
+  //4. 다음 위치를 기록한다.
+  c.after = k.after;
+  c.last_pid = k.pid;
+  c.last_va = k.va;
+  c.done = (c.pfn >= IPT_PFN_END);
+  if (copyout(curproc->pgdir, (uint)uc, (char *)&c, sizeof(c)) < 0)
+    return -1;
+  return copied;
+}
+
+/**
+ * @brief 락 없이 (pid, va) 인덱스에서 매핑을 찾는다.
+ *
+ * @param pid : 프로세스 ID
+ * @param va : 페이지 정렬된 가상 주소
+ * @param pfn_out : 찾은 물리 프레임 번호
+ * @param flags_out : 찾은 엔트리의 플래그 스냅샷
+ * @return 찾으면 1, 없으면 0
+ */
+static int ipt_translate(uint pid, uint va, uint *pfn_out, uint *flags_out) {
+  struct ipt_entry *e;
+  uint seq, probes;
+  int found, tries, locked;
+
+  ipt_read_begin();
+  locked = 0;
+  for (tries = 0; ; tries++) {
+    //1. 버킷 이동 중이면 끝날 때까지 기다린다. (ipt_lookup과 같은 규칙)
+    if (tries == IPT_READ_RETRIES) {
+      ipt_acquire();
+      locked = 1;
+    }
+    while ((seq = ipt.seq) & 1)
+      ;
+    __sync_synchronize();
+
+    //2. (pid, va) 체인을 순회한다.
+    found = 0;
+    probes = 0;
+    for (e = *ipt_vbucket(pid, va); e; e = e->vnext) {
+      probes++;
+      if (e->pid == pid && e->va == va) {
+        *pfn_out = e->pfn;
+        *flags_out = e->flags;
+        found = 1;
+        break;
       }
     }
+
+    //3. 순회 중에 버킷 이동이 없었으면 결과가 유효하다.
+    __sync_synchronize();
+    if (locked || ipt.seq == seq)
+      break;
   }
-  //11. 락 해제 후 함수를 종료한다.
-  release(&ipt_lock);
+  ipt_count_lookup(probes);
+  if (locked)
+    release(&ipt_lock);
+  ipt_read_end();
+  return found;
+}
+
+/**
+ * @brief 페이지 순회로 TLB 미스를 처리한 뒤, 같은 페이지 테이블의 다음 PTE들을 TLB에 미리 채운다.
+ *
+ * stride 검출: 이번 미스가 직전 미스에서 선반입한 페이지 바로 다음이면 순차 접근으로 보고 선반입 수를
+ * 두 배로 늘리고(최대 sw_tlb_pf_max), 아니면 절반으로 줄인다. 순차 접근이 아니면 곧 0이 되어 선반입하지 않는다.
+ * 선반입은 같은 페이지 테이블 페이지 안에서, 존재하는 PTE를 만날 때까지만 한다. (PDE를 다시 읽지 않는다.)
+ *
+ * @param p : 미스를 낸 프로세스 (자기 주소 공간)
+ * @param own : 전용 TLB 모드이면 p, 아니면 0
+ * @param tag : p의 주소 공간 태그
+ * @param pgtab : 미스 난 주소의 페이지 테이블
+ * @param va_page : 미스 난 가상 페이지
+ */
+static void sw_tlb_prefetch(struct proc *p, struct proc *own, uint tag, pte_t *pgtab, uint va_page) {
+  uint degree = p->tlb_pf_degree;
+  uint i, n, idx, filled = 0;
+  pte_t pte;
+
+  //1. 순차 접근인지 확인하고 선반입 수를 조정한다.
+  if (va_page == p->tlb_pf_next)
+    degree = degree ? degree * 2 : 1;
+  else
+    degree /= 2;
+  if (degree > sw_tlb_pf_max)
+    degree = sw_tlb_pf_max;
+  p->tlb_pf_degree = degree;
+
+  //2. 다음 PTE들을 채운다. 페이지 테이블 끝이나 존재하지 않는 PTE에서 멈춘다.
+  idx = va_page % NPTENTRIES;
+  for (i = 1, n = 0; i <= degree && idx + i < NPTENTRIES; i++) {
+    pte = pgtab[idx + i];
+    if ((pte & PTE_P) == 0)
+      break;
+    if (own)
+      filled += sw_ptlb_insert(own, va_page + i, PTE_ADDR(pte) >> 12, PTE_FLAGS(pte), 1);
+    else
+      filled += sw_tlb_insert(tag, va_page + i, PTE_ADDR(pte) >> 12, PTE_FLAGS(pte), 1);
+    n = i;
+  }
+
+  //3. 순차 접근이면 다음 미스는 선반입한 페이지 바로 다음에서 난다.
+  p->tlb_pf_next = va_page + 1 + n;
+
+  pushcli();
+  sw_tlb[cpuid()].pf_issued += filled;
+  popcli();
 }
 
 /**
@@ -471,17 +3606,27 @@ void ipt_remove_by_pid(uint pid) {
  */
 int
 sw_vtop(pde_t *pgdir, const void *va, uint *pa_out, uint *pte_flags_out) {
-  pde_t *pde;
   pte_t *pgtab;
   pte_t *pte;
 
   uint pa;
   uint pid = myproc() ? myproc()->pid : 0;
+  uint tag = sw_tlb_tag(myproc());
   uint va_page = (uint)va >> 12;
   uint flags;
+  int hit;
 
-  //1. SW TLB 캐시 조회
-  if (sw_tlb_lookup(pid, va_page, &pa, &flags)) {
+  //0. 전용 TLB 모드이고 자기 주소 공간이면 프로세스 전용 TLB를 쓴다.
+  struct proc *own = (sw_tlb_private && myproc() && pgdir == myproc()->pgdir) ? myproc() : 0;
+
+  //1. SW TLB 캐시 조회 (공유 TLB는 set에 없으면 victim buffer, L2까지, 크기가 바뀌었으면 먼저 맞춘다.)
+  if (own) {
+    hit = sw_ptlb_lookup(own, va_page, &pa, &flags);
+  } else {
+    sw_tlb_sync_size();
+    hit = sw_tlb_lookup(tag, va_page, &pa, &flags, 0);
+  }
+  if (hit) {
     //1-1. 캐시 힛
     if (pa_out)
       *pa_out = pa | ((uint)va & 0xFFF); //페이지 주소 + 오프셋
@@ -493,15 +3638,47 @@ sw_vtop(pde_t *pgdir, const void *va, uint *pa_out, uint *pte_flags_out) {
   }
 
   //2. MISS
+  //2-0. IPT 변환 모드이면 (pid, va) 인덱스에서 먼저 찾는다.
+  //     IPT에 없는 매핑(추적을 끈 동안 생긴 매핑 등)은 아래 페이지 테이블 순회로 찾는다.
+  if (sw_vtop_ipt && myproc() && pgdir == myproc()->pgdir) {
+    ipt_log_flush();
+    if (ipt_translate(pid, va_page << 12, &pa, &flags) && (flags & PTE_P)) {
+      if (pa_out)
+        *pa_out = (pa << 12) | ((uint)va & 0xFFF);
+      if (pte_flags_out)
+        *pte_flags_out = flags;
+      if (own)
+        sw_ptlb_insert(own, va_page, pa, flags, 0);
+      else
+        sw_tlb_insert(tag, va_page, pa, flags, 0);
+      return 0;
+    }
+  }
+
+  //2-1. page-walk cache에서 페이지 테이블을 찾는다. 없으면 PDE를 읽는다.
   uint pde_idx = PDX(va);
-  pde = &pgdir[pde_idx];
+  if ((pgtab = sw_pwc_walk(pgdir, pde_idx)) == 0) {
+    //2-2. 페이지 테이블이 없으면 4MB 큰 페이지인지 본다. (PDE가 없으면 실패)
+    pde_t pde = pgdir[pde_idx];
+    if ((pde & (PTE_P | PTE_PS)) != (PTE_P | PTE_PS))
+      return -1;
 
-  //2-1. 존재하지 않을 경우
-  if ((*pde & PTE_P) == 0)
-    return -1;
+    //2-3. PDE가 곧 변환이다. 4KB 조각의 주소를 구해 큰 페이지 TLB에 4MB 엔트리 하나로 채운다.
+    //     (전용 TLB는 direct-mapped 4KB 엔트리뿐이므로 조각 하나로 채운다.)
+    pa = PTE_ADDR(pde) + PTX(va) * PGSIZE;
+    flags = PTE_FLAGS(pde);
+    if (pa_out)
+      *pa_out = pa | ((uint)va & 0xFFF);
+    if (pte_flags_out)
+      *pte_flags_out = flags;
+    if (own)
+      sw_ptlb_insert(own, va_page, pa >> 12, flags, 0);
+    else
+      sw_tlb_huge_insert(tag, va_page & ~(NPTENTRIES - 1), PTE_ADDR(pde) >> 12, flags);
+    return 0;
+  }
 
   //3. PTE 확인
-  pgtab = (pte_t *)P2V(PTE_ADDR(*pde));
   uint pte_idx = PTX(va);
   pte = &pgtab[pte_idx];
 
@@ -520,7 +3697,14 @@ sw_vtop(pde_t *pgdir, const void *va, uint *pa_out, uint *pte_flags_out) {
     *pte_flags_out = flags;
 
   //5. TLB에 삽입
-  sw_tlb_insert(pid, va_page, PTE_ADDR(*pte) >> 12, flags);
+  if (own)
+    sw_ptlb_insert(own, va_page, PTE_ADDR(*pte) >> 12, flags, 0);
+  else
+    sw_tlb_insert(tag, va_page, PTE_ADDR(*pte) >> 12, flags, 0);
+
+  //6. 자기 주소 공간이면 다음 페이지들을 선반입한다.
+  if (sw_tlb_pf_max > 0 && myproc() && pgdir == myproc()->pgdir)
+    sw_tlb_prefetch(myproc(), own, tag, pgtab, va_page);
 
   return 0;   //캐시 미스
 }
@@ -547,6 +3731,7 @@ seginit(void)
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
+// 4MB 큰 페이지에는 PTE가 없으므로 호출자가 먼저 walkpte()로 읽거나 hugesplit()으로 쪼개야 한다.
 static pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
@@ -554,6 +3739,8 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   pte_t *pgtab;
 
   pde = &pgdir[PDX(va)];
+  if(*pde & PTE_PS)
+    panic("walkpgdir: huge page");
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
@@ -569,6 +3756,116 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   return &pgtab[PTX(va)];
 }
 
+/**
+ * @brief va가 매핑된 4KB 페이지의 PTE 값을 읽는다. 4MB 큰 페이지이면 그 안의 4KB 조각에 해당하는 값을 만들어 준다.
+ *
+ * @return PTE 값 (큰 페이지이면 PTE_ADDR은 조각의 주소이고 PTE_PS가 켜져 있다.), 페이지 테이블이 없으면 0
+ */
+static pte_t
+walkpte(pde_t *pgdir, const void *va)
+{
+  pde_t pde = pgdir[PDX(va)];
+  pte_t *pte;
+
+  if((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+    return (PTE_ADDR(pde) + PTX(va) * PGSIZE) | PTE_FLAGS(pde);
+  if((pte = walkpgdir(pgdir, va, 0)) == 0)
+    return 0;
+  return *pte;
+}
+
+/**
+ * @brief 4MB 큰 페이지 매핑을 같은 프레임을 가리키는 4KB PTE 1024개로 쪼갠다. (그 안의 한 페이지만 바꾸거나 해제할 때)
+ *        프레임은 원래 4KB 페이지를 떼어 온 것이므로 쪼갠 뒤에는 보통 페이지처럼 하나씩 해제할 수 있다.
+ *        변환은 그대로이므로 하드웨어 TLB는 비우지 않아도 되고, SW TLB의 큰 페이지 엔트리는
+ *        호출자가 그 안의 페이지를 무효화할 때 함께 지워진다.
+ *
+ * @return 0 (큰 페이지가 아니면 아무것도 하지 않는다.), 페이지 테이블을 할당하지 못하면 -1
+ */
+static int
+hugesplit(pde_t *pgdir, const void *va)
+{
+  pde_t *pde = &pgdir[PDX(va)];
+  pte_t *pgtab;
+  uint i, pa, flags;
+
+  if((*pde & (PTE_P | PTE_PS)) != (PTE_P | PTE_PS))
+    return 0;
+  if((pgtab = (pte_t*)kalloc()) == 0)
+    return -1;
+  pa = PTE_ADDR(*pde);
+  flags = PTE_FLAGS(*pde) & ~PTE_PS;
+  for(i = 0; i < NPTENTRIES; i++)
+    pgtab[i] = (pa + i * PGSIZE) | flags;
+  *pde = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+  vm_huge_stat.splits++;
+  return 0;
+}
+
+/**
+ * @brief va가 속한 4MB 큰 페이지가 해제할 범위 [lo, hi)에 일부만 걸치면 4KB 페이지로 쪼갠다.
+ *        통째로 범위 안이면 deallocuvm이 한 번에 해제하도록 그대로 둔다.
+ *
+ * @return 0 (쪼갰거나 쪼갤 필요가 없음), 페이지 테이블을 할당하지 못하면 -1
+ */
+static int
+hugesplit_edge(pde_t *pgdir, uint va, uint lo, uint hi)
+{
+  uint base = va & ~(HUGEPGSIZE - 1);
+
+  if(base >= lo && hi - base >= HUGEPGSIZE)
+    return 0;
+  return hugesplit(pgdir, (char*)va);
+}
+
+/**
+ * @brief 4MB로 정렬된 가상 구간 a에 연속 물리 페이지 1024개를 큰 페이지 하나로 매핑하고, IPT에는 4KB 프레임마다 등록한다.
+ *        IPT 플래그에는 PTE_PS를 넣지 않는다. hugesplit()이 쪼갠 뒤의 4KB PTE와 플래그가 그대로 같게 하기 위해서다.
+ *
+ * @return 0 성공, 연속 물리 페이지가 없으면 -1 (호출자는 4KB 페이지로 대신한다.)
+ */
+static int
+hugemap(pde_t *pgdir, uint a)
+{
+  struct proc *p = myproc();
+  char *mem;
+  uint i, pfn;
+
+  if((mem = kalloc_huge()) == 0){
+    vm_huge_stat.fallbacks++;
+    return -1;
+  }
+  memset(mem, 0, HUGEPGSIZE);
+  pgdir[PDX(a)] = V2P(mem) | PTE_P | PTE_W | PTE_U | PTE_PS;
+
+  if(p){
+    pfn = V2P(mem) / PGSIZE;
+    for(i = 0; i < NPTENTRIES; i++)
+      ipt_insert(pfn + i, p->pid, a + i * PGSIZE, PTE_FLAGS(pgdir[PDX(a)]) & ~PTE_PS);
+  }
+  vm_huge_stat.mapped++;
+  return 0;
+}
+
+/**
+ * @brief 4MB로 정렬된 가상 구간 a의 큰 페이지를 통째로 해제한다. 프레임은 4KB 페이지마다 free list로 돌려준다.
+ */
+static void
+hugefree(pde_t *pgdir, uint a)
+{
+  struct proc *p = myproc();
+  uint i, pa;
+
+  pa = PTE_ADDR(pgdir[PDX(a)]);
+  for(i = 0; i < NPTENTRIES; i++){
+    if(p && p->pid > 0)
+      ipt_remove((pa + i * PGSIZE) / PGSIZE, p->pid, a + i * PGSIZE);
+    kfree(P2V(pa + i * PGSIZE));
+  }
+  pgdir[PDX(a)] = 0;
+  vm_huge_stat.freed++;
+}
+
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
@@ -692,6 +3989,13 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
+  //exec가 새 주소 공간으로 바꿨으면 이전 주소 공간의 TLB 엔트리를 태그째 버린다. (O(1), 이전 페이지 디렉터리는 곧 freevm된다.)
+  //fork 직후의 자식은 tlb_pgdir가 0이므로 미리 채워 둔 엔트리를 그대로 쓴다.
+  if (p->tlb_pgdir != p->pgdir) {
+    if (p->tlb_pgdir)
+      sw_tlb_flush_proc(p);
+    p->tlb_pgdir = p->pgdir;
+  }
   lcr3(V2P(p->pgdir));  // switch to process's address space
   popcli();
 }
@@ -717,14 +4021,14 @@ int
 loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 {
   uint i, pa, n;
-  pte_t *pte;
+  pte_t pte;
 
   if((uint) addr % PGSIZE != 0)
     panic("loaduvm: addr must be page aligned");
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, addr+i, 0)) == 0)
+    if((pte = walkpte(pgdir, addr+i)) == 0)
       panic("loaduvm: address should exist");
-    pa = PTE_ADDR(*pte);
+    pa = PTE_ADDR(pte);
     if(sz - i < PGSIZE)
       n = sz - i;
     else
@@ -737,6 +4041,8 @@ loaduvm(pde_t *pgdir, char *addr, struct inode *ip, uint offset, uint sz)
 
 // Allocate page tables and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// 4MB로 정렬된 구간이 통째로 새로 늘어나면 연속 물리 페이지를 얻어 PSE 큰 페이지 하나로 매핑한다.
+// (페이지 테이블 페이지와 PTE 1024개가 필요 없다.) 연속 물리 페이지가 없으면 4KB 페이지로 대신한다.
 int
 allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 {
@@ -750,6 +4056,15 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
+    //1. 큰 페이지로 매핑할 수 있는 구간이면 한 번에 매핑한다.
+    if(vm_huge_on && a % HUGEPGSIZE == 0 && newsz - a >= HUGEPGSIZE &&
+       (pgdir[PDX(a)] & PTE_P) == 0 && hugemap(pgdir, a) == 0){
+      a += HUGEPGSIZE - PGSIZE;
+      continue;
+    }
+    //2. deallocuvm은 걸친 큰 페이지를 쪼개거나 실패하면 줄이지 않으므로 sz 위에 큰 페이지가 남아 있을 수 없다.
+    if(pgdir[PDX(a)] & PTE_PS)
+      panic("allocuvm: huge page above sz");
     mem = kalloc();
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
@@ -790,9 +4105,34 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   if(newsz >= oldsz)
     return oldsz;
+  //같은 페이지 안에서만 줄어들면 해제할 페이지가 없으므로 쪼갤 필요도 없다.
+  if(PGROUNDUP(newsz) >= oldsz)
+    return newsz;
+
+  //범위 양 끝에 일부만 걸친 4MB 큰 페이지는 먼저 4KB 페이지로 쪼갠다.
+  //쪼갤 페이지 테이블을 얻지 못하면 아무것도 해제하지 않고 0을 돌려준다. (growproc이 실패로 알린다.)
+  //일부만 해제하고 크기를 줄이면 줄인 크기 위의 프레임이 매핑된 채 남아 새어 나간다.
+  if(hugesplit_edge(pgdir, PGROUNDUP(newsz), PGROUNDUP(newsz), oldsz) < 0 ||
+     hugesplit_edge(pgdir, oldsz - 1, PGROUNDUP(newsz), oldsz) < 0){
+    cprintf("deallocuvm: cannot split huge page\n");
+    return 0;
+  }
+
+  //해제할 범위 전체를 TLB에서 한 번에 무효화한다. (프레임을 돌려주기 전에)
+  struct proc *curproc = myproc();
+  if (curproc && curproc->pid > 0) {
+    sw_tlb_invalidate_range(curproc->tlb_tag, PGROUNDUP(newsz), oldsz);
+    sw_ptlb_invalidate(curproc, PGROUNDUP(newsz), oldsz);
+  }
 
   a = PGROUNDUP(newsz);
   for(; a  < oldsz; a += PGSIZE){
+    //4MB 큰 페이지: 양 끝은 위에서 쪼갰으므로 여기서 만나는 큰 페이지는 통째로 범위 안이다. 한 번에 해제한다.
+    if((pgdir[PDX(a)] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)){
+      hugefree(pgdir, a);
+      a += HUGEPGSIZE - PGSIZE;
+      continue;
+    }
     pte = walkpgdir(pgdir, (char*)a, 0);
 
     if(!pte)
@@ -800,12 +4140,11 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
     else if((*pte & PTE_P) != 0){
       pa = PTE_ADDR(*pte);
 
-      //IPT, TLB에서 엔트리 삭제
+      //IPT에서 엔트리 삭제 (TLB는 위에서 범위로 무효화했다.)
       struct proc *p = myproc();
       if (p && p->pid > 0) {
         uint pfn = pa / PGSIZE;
         ipt_remove(pfn, p->pid, a);
-        sw_tlb_invalidate(p->pid, a);
       }
 
       if(pa == 0)
@@ -828,6 +4167,10 @@ freevm(pde_t *pgdir)
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
+  //TLB 태그는 프로세스가 쓰는 주소 공간이 바뀔 때 switchuvm()에서 버린다.
+  //여기서 버리면 wait()가 자식을, fork/exec 실패 경로가 새 주소 공간을 해제할 때 호출한 프로세스의 태그까지 버리게 된다.
+  //페이지 테이블 페이지를 해제하기 전에 page-walk cache를 모두 무효화한다.
+  sw_pwc_gen++;
   deallocuvm(pgdir, KERNBASE, 0);
   for(i = 0; i < NPDENTRIES; i++){
     if(pgdir[i] & PTE_P){
@@ -845,6 +4188,8 @@ clearpteu(pde_t *pgdir, char *uva)
 {
   pte_t *pte;
 
+  if(hugesplit(pgdir, uva) < 0)
+    panic("clearpteu: split");
   pte = walkpgdir(pgdir, uva, 0);
   if(pte == 0)
     panic("clearpteu");
@@ -858,7 +4203,8 @@ clearpteu(pde_t *pgdir, char *uva)
     uint new_flags = PTE_FLAGS(*pte);
 
     ipt_update_flags(pfn, p->pid, va, new_flags);
-    sw_tlb_invalidate(p->pid, va);
+    sw_tlb_invalidate(p->tlb_tag, va);
+    sw_ptlb_invalidate(p, va, va + PGSIZE);
   }
 }
 
@@ -868,19 +4214,30 @@ pde_t*
 copyuvm(pde_t *pgdir, uint sz)
 {
   pde_t *d;
-  pte_t *pte;
+  pte_t pte;
   uint pa, i, flags;
   char *mem;
 
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
+    //4MB 큰 페이지: 자식도 연속 물리 페이지를 얻으면 통째로 복사하고, 아니면 아래에서 4KB 페이지로 복사한다.
+    if(i % HUGEPGSIZE == 0 && (pgdir[PDX(i)] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS)){
+      if((mem = kalloc_huge()) != 0){
+        memmove(mem, (char*)P2V(PTE_ADDR(pgdir[PDX(i)])), HUGEPGSIZE);
+        d[PDX(i)] = V2P(mem) | PTE_FLAGS(pgdir[PDX(i)]);
+        vm_huge_stat.mapped++;
+        i += HUGEPGSIZE - PGSIZE;
+        continue;
+      }
+      vm_huge_stat.fallbacks++;
+    }
+    if((pte = walkpte(pgdir, (void *) i)) == 0)
       panic("copyuvm: pte should exist");
-    if(!(*pte & PTE_P))
+    if(!(pte & PTE_P))
       panic("copyuvm: page not present");
-    pa = PTE_ADDR(*pte);
-    flags = PTE_FLAGS(*pte);
+    pa = PTE_ADDR(pte);
+    flags = PTE_FLAGS(pte) & ~PTE_PS;
     if((mem = kalloc()) == 0)
       goto bad;
     memmove(mem, (char*)P2V(pa), PGSIZE);
@@ -896,19 +4253,314 @@ bad:
   return 0;
 }
 
+/**
+ * @brief fork 시 자식 프로세스의 모든 매핑을 IPT에 한 번에 등록한다.
+ *
+ * copyuvm()이 만든 자식 페이지 테이블을 한 번 순회하면서 (pfn, va, flags)를
+ * ipt_lock을 한 번만 잡은 채로 일괄 삽입한다. 자식 PID는 새로 만들어졌으므로
+ * 중복 검사도 생략한다.
+ *
+ * @param pgdir : 자식 프로세스의 페이지 디렉터리
+ * @param sz : 자식 프로세스의 메모리 크기
+ * @param pid : 자식 프로세스의 PID
+ */
+void ipt_clone(pde_t *pgdir, uint sz, uint pid) {
+  pte_t pte;
+  uint i;
+
+  if (!ipt_initialized || !ipt_tracking) return ;
+
+  //1. 지연 모드에서는 다른 변경과 같은 순서로 반영되도록 페이지마다 ipt_insert()로 로그에 남긴다.
+  if (ipt_deferred) {
+    for (i = 0; i < sz; i += PGSIZE) {
+      if ((pte = walkpte(pgdir, (void *)i)) != 0 && (pte & PTE_P))
+        ipt_insert(PTE_ADDR(pte) / PGSIZE, pid, i, PTE_FLAGS(pte) & ~PTE_PS);
+    }
+    return ;
+  }
+
+  //1-1. 락 획득 (fork 한 번에 한 번), 로그에 남은 변경을 먼저 반영해 순서를 지킨다.
+  ipt_acquire();
+  ipt_log_drain();
+  ipt_operations++;
+
+  //2. 자식의 사용자 영역을 순회하며 존재하는 페이지를 모두 등록한다.
+  for (i = 0; i < sz; i += PGSIZE) {
+    if ((pte = walkpte(pgdir, (void *)i)) == 0 || !(pte & PTE_P))
+      continue;
+    //   큰 페이지도 4KB 프레임 단위로 등록하므로 PTE_PS는 빼고 등록한다.
+    if (ipt_insert_locked(PTE_ADDR(pte) / PGSIZE, pid, i, PTE_FLAGS(pte) & ~PTE_PS, 0) < 0) {
+      release(&ipt_lock);
+      panic("ipt_clone: out of memory");
+    }
+    //2-1. 테이블이 커지는 중이면 삽입과 함께 조금씩 옮긴다.
+    ipt_maintain();
+  }
+
+  //3. 락 해제
+  release(&ipt_lock);
+}
+
+/**
+ * @brief fork 직후 부모가 지금 쓰고 있는 페이지의 변환을 자식 태그로 미리 채운다. (자식의 첫 vtop들이 모두 미스가 나지 않도록)
+ *
+ * 부모가 이 CPU의 L1(set, victim buffer)에 가진 엔트리를 최대 SW_TLB_WARM_MAX개 골라, 자식 페이지 테이블에서
+ * 복사된 새 프레임으로 다시 변환해 채운다. 자식이 어느 CPU에서 돌지 모르므로 L2가 켜져 있으면 모든 CPU가 보는 L2에,
+ * 꺼져 있으면 이 CPU의 L1에 채운다. 다른 프로세스의 엔트리를 밀어내지 않도록 빈 way에만 채우고 자리가 없으면 건너뛴다.
+ * 전용 TLB 모드이면 부모의 전용 TLB를 자식의 전용 TLB로 옮긴다. (자식만 쓰는 TLB이므로 밀려날 엔트리가 없다.)
+ *
+ * @param parent : fork를 호출한 현재 프로세스
+ * @param child : copyuvm이 끝나고 아직 RUNNABLE이 아닌 자식
+ */
+void sw_tlb_fork_warm(struct proc *parent, struct proc *child) {
+  uint va[SW_TLB_WARM_MAX];
+  struct sw_tlb_entry n, *e;
+  struct sw_tlb *t;
+  uint ptag, ctag;
+  int i, w, cnt = 0, filled = 0;
+  pte_t pte;
+
+  if (!sw_tlb_fork_warm_on)
+    return ;
+
+  //1. 뜨거운 페이지를 모은다. 전용 TLB 모드이면 부모의 전용 TLB에서,
+  //   아니면 부모가 이 CPU의 L1에 가진 엔트리에서 모은다. (현재 세대의 태그가 없으면 모을 것도 없다.)
+  if (sw_tlb_private) {
+    for (i = 0; i < PTLB_SIZE; i++) {
+      if (parent->ptlb[i].valid)
+        va[cnt++] = parent->ptlb[i].va_page;
+    }
+  } else {
+    ptag = parent->tlb_tag;
+    if (ptag == 0 || (ptag >> SW_TLB_ASID_BITS) != sw_tlb_asid.gen)
+      return ;
+    pushcli();
+    t = &sw_tlb[cpuid()];
+    for (i = 0; i < t->nsets && cnt < SW_TLB_WARM_MAX; i++) {
+      for (w = 0; w < SW_TLB_WAYS && cnt < SW_TLB_WARM_MAX; w++) {
+        e = &sw_tlb_set(t, i)[w];
+        if (e->valid && e->tag == ptag)
+          va[cnt++] = e->va_page;
+      }
+    }
+    for (i = 0; i < SW_TLB_VICTIM && cnt < SW_TLB_WARM_MAX; i++) {
+      e = &t->victim[i];
+      if (e->valid && e->tag == ptag)
+        va[cnt++] = e->va_page;
+    }
+    popcli();
+  }
+
+  //2. 자식 페이지 테이블에서 다시 변환해 채운다.
+  ctag = sw_tlb_tag(child);
+  for (i = 0; i < cnt; i++) {
+    pte = walkpte(child->pgdir, (char *)(va[i] << 12));
+    if ((pte & PTE_P) == 0)
+      continue;
+    if (sw_tlb_private) {
+      filled += sw_ptlb_insert(child, va[i], PTE_ADDR(pte) >> 12, PTE_FLAGS(pte), 0);
+      continue;
+    }
+    n.tag = ctag;
+    n.va_page = va[i];
+    n.pa_page = PTE_ADDR(pte) >> 12;
+    n.flags = PTE_FLAGS(pte);
+    n.valid = 1;
+    n.age = 0;
+    n.prefetched = 0;
+    n.cls = child->tlb_class;
+    n.pid = child->pid;
+    if (sw_tlb_l2_mode != TLB_L2_OFF)
+      filled += sw_tlb_l2_fill_free(&n, sw_tlb_l2_mask[child->tlb_class]);
+    else
+      filled += sw_tlb_fill_free(&n, sw_tlb_l1_mask[child->tlb_class]);
+  }
+
+  //3. 통계
+  pushcli();
+  sw_tlb[cpuid()].warm_filled += filled;
+  sw_tlb[cpuid()].warm_skipped += cnt - filled;
+  popcli();
+}
+
+/**
+ * @brief IPT 동작을 제어하는 시스템 콜
+ *
+ * @param cmd : IPT_CTL_TRACK - arg가 0이면 새 매핑 등록을 멈추고, 1이면 다시 등록한다.
+ *              (제거는 계속 반영되므로 꺼져 있던 동안의 매핑만 IPT에서 빠진다.)
+ *              IPT_CTL_RESET_STATS - 조회/락/로그 통계를 초기화한다.
+ *              IPT_CTL_DEFER - arg가 1이면 매핑 변경을 CPU별 로그에 모았다가 조회 시점에 반영하고,
+ *              0이면 즉시 반영으로 돌아간다.
+ *              IPT_CTL_VTOP - arg가 1이면 sw_vtop의 TLB 미스를 페이지 테이블 대신
+ *              (pid, va) IPT 인덱스로 처리하고, 0이면 페이지 테이블 순회로 돌아간다.
+ * @param arg : 명령 인자
+ *
+ * @return 이전 설정 값, 잘못된 명령이면 -1
+ */
+int sys_ipt_ctl(void) {
+  int cmd, arg, old;
+
+  if (argint(0, &cmd) < 0 || argint(1, &arg) < 0)
+    return -1;
+
+  switch (cmd) {
+  case IPT_CTL_TRACK:
+    old = ipt_tracking;
+    ipt_tracking = (arg != 0);
+    return old;
+  case IPT_CTL_RESET_STATS:
+    ipt_acquire();
+    memset(ipt_pcpu, 0, sizeof(ipt_pcpu));
+    ipt_dup_bumps = 0;
+    ipt_operations = 0;
+    ipt_lock_count = 0;
+    ipt_lock_contended = 0;
+    ipt_lock_wait = 0;
+    ipt_log_drains = 0;
+    ipt_log_applied = 0;
+    release(&ipt_lock);
+    return 0;
+  case IPT_CTL_DEFER:
+    old = ipt_deferred;
+    ipt_deferred = (arg != 0);
+    //지연 모드를 끄면 쌓여 있던 변경을 바로 반영한다.
+    //모드를 내린 것이 보인 뒤에 로그를 읽어야 그 사이 기록한 CPU와 엇갈리지 않는다.
+    if (!ipt_deferred) {
+      __sync_synchronize();
+      ipt_acquire();
+      ipt_log_drain();
+      release(&ipt_lock);
+    }
+    return old;
+  case IPT_CTL_VTOP:
+    old = sw_vtop_ipt;
+    sw_vtop_ipt = (arg != 0);
+    return old;
+  }
+  return -1;
+}
+
+/**
+ * @brief 테이블 하나의 체인 길이 분포를 통계에 더한다. ipt_lock을 잡은 상태에서 호출해야 한다.
+ *
+ * @param t : 조사할 테이블
+ * @param from : 조사를 시작할 버킷 (크기 변경 중인 old는 아직 옮기지 않은 버킷만 본다)
+ * @param st : 결과를 더할 통계 구조체
+ */
+static void ipt_stat_table(struct ipt_table *t, uint from, struct ipt_stat *st) {
+  struct ipt_entry *e;
+  uint i, len, bin;
+
+  for (i = from; i < (1 << t->shift); i++) {
+    len = 0;
+    for (e = *ipt_slot(t, i); e; e = e->next)
+      len++;
+
+    if (len > 0)
+      st->used_buckets++;
+    if (len > st->max_chain)
+      st->max_chain = len;
+
+    //0~4는 그대로, 그 이상은 2의 거듭제곱 구간으로 묶는다.
+    if (len <= 4)
+      bin = len;
+    else if (len <= 8)
+      bin = 5;
+    else if (len <= 16)
+      bin = 6;
+    else
+      bin = 7;
+    st->chain_hist[bin]++;
+  }
+}
+
+/**
+ * @brief IPT 통계를 유저 공간으로 복사하는 시스템 콜
+ *
+ * @param st : 결과를 저장할 유저 공간 struct ipt_stat 포인터
+ * @return 0 성공, -1 실패
+ */
+int sys_ipt_stat(void) {
+  struct ipt_stat *ust;
+  struct ipt_stat st;
+  int i;
+
+  //1. 인자 받기
+  if (argptr(0, (char **)&ust, sizeof(st)) < 0)
+    return -1;
+
+  memset(&st, 0, sizeof(st));
+
+  //2. 테이블이 바뀌지 않도록 락을 잡고, 쌓인 변경을 반영한 뒤 체인 분포를 센다.
+  ipt_acquire();
+  ipt_log_drain();
+  st.entries = ipt.count;
+  st.buckets = 1 << ipt.cur->shift;
+  ipt_stat_table(ipt.cur, 0, &st);
+  if (ipt.old) {
+    ipt_stat_table(ipt.old, ipt.rehash_idx, &st);
+    st.resizing = 1;
+  }
+  st.dup_bumps = ipt_dup_bumps;
+  st.operations = ipt_operations;
+  st.lock_acquires = ipt_lock_count;
+  st.lock_contended = ipt_lock_contended;
+  st.lock_wait_kcycles = (uint)(ipt_lock_wait >> 10);
+  st.deferred = ipt_deferred;
+  st.log_drains = ipt_log_drains;
+  st.log_applied = ipt_log_applied;
+  release(&ipt_lock);
+
+  //3. CPU별 조회 통계를 합친다.
+  for (i = 0; i < NCPU; i++) {
+    st.lookups += ipt_pcpu[i].lookups;
+    st.probes += ipt_pcpu[i].probes;
+  }
+  if (st.lookups > 0)
+    st.avg_probes_x100 = st.probes * 100 / st.lookups;
+
+  //4. 유저 공간으로 복사
+  if (copyout(myproc()->pgdir, (uint)ust, (char *)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
+// 현재 프로세스의 주소 공간이면 공유 SW TLB를 거친다. (copyout이 레코드마다 같은 페이지를 다시 순회하지 않도록)
+// 다른 주소 공간(exec가 만드는 새 pgdir 등)에는 태그가 없으므로 그대로 순회한다.
+// 페이지 할당을 하지 않으므로 락을 잡은 채 copyout하는 경로(dump_physmem_info)에서도 쓸 수 있다.
 char*
 uva2ka(pde_t *pgdir, char *uva)
 {
-  pte_t *pte;
+  struct proc *p = myproc();
+  uint tag = 0, pa, flags;
+  pte_t pte;
+
+  //1. 자기 주소 공간이면 TLB에서 찾는다. 캐시된 플래그로 PTE_P, PTE_U를 똑같이 확인한다.
+  if (sw_tlb_kcopy && p && pgdir == p->pgdir) {
+    tag = sw_tlb_tag(p);
+    if (sw_tlb_lookup(tag, (uint)uva >> 12, &pa, &flags, 1)) {
+      if ((flags & (PTE_P | PTE_U)) != (PTE_P | PTE_U))
+        return 0;
+      return (char*)P2V(pa);
+    }
+  }
 
-  pte = walkpgdir(pgdir, uva, 0);
-  if((*pte & PTE_P) == 0)
+  //2. 페이지 테이블을 순회한다. (4MB 큰 페이지이면 PDE에서 4KB 조각의 주소를 구한다.)
+  pte = walkpte(pgdir, uva);
+  if((pte & PTE_P) == 0)
     return 0;
-  if((*pte & PTE_U) == 0)
+
+  //3. 자기 주소 공간이면 TLB에 채운다. (유저 접근이 불가능한 페이지도 채워 두어 다음에 바로 거른다.)
+  if (tag && (pte & PTE_PS))
+    sw_tlb_huge_insert(tag, ((uint)uva >> 12) & ~(NPTENTRIES - 1),
+                       (PTE_ADDR(pte) >> 12) & ~(NPTENTRIES - 1), PTE_FLAGS(pte));
+  else if (tag)
+    sw_tlb_insert(tag, (uint)uva >> 12, PTE_ADDR(pte) >> 12, PTE_FLAGS(pte), 0);
+  if((pte & PTE_U) == 0)
     return 0;
-  return (char*)P2V(PTE_ADDR(*pte));
+  return (char*)P2V(PTE_ADDR(pte));
 }
 
 // Copy len bytes from p to user address va in page table pgdir.
@@ -953,6 +4605,8 @@ int setpageflags_in(pde_t *pgdir, uint addr, uint flags) {
   //페이지 정렬
   addr = PGROUNDDOWN(addr);
 
+  //4MB 큰 페이지이면 이 페이지만 바꿀 수 있도록 쪼갠다.
+  if (hugesplit(pgdir, (char *)addr) < 0) return -1;
   pte = walkpgdir(pgdir, (char *)addr, 0);
   if (!pte || !(*pte & PTE_P)) return -1;
 
@@ -966,7 +4620,8 @@ int setpageflags_in(pde_t *pgdir, uint addr, uint flags) {
   if (p && p->pid > 0) {
     ipt_update_flags(pfn, p->pid, addr, flags);
   }
-  sw_tlb_invalidate(p->pid, addr);
+  sw_tlb_invalidate(p->tlb_tag, addr);
+  sw_ptlb_invalidate(p, addr, addr + PGSIZE);
   return 0;
 }
 